@@ -0,0 +1,82 @@
+#ifndef ADVECT_KERNELS_H
+#define ADVECT_KERNELS_H
+
+#include <cstdint>
+#include "field.h"
+#include "storage_precision.h"
+#include "volume_field.h"
+
+// Instruction sets the advection kernels are built for
+enum class SimdLevel
+{
+    Scalar,
+    SSE41,  // 4 lanes, gathers emulated with scalar loads
+    AVX2,   // 8 lanes, hardware gathers
+    AVX512  // 16 lanes, hardware gathers
+};
+
+// Row kernels for the advection back-trace and bilinear sampling, and for
+// the relaxation sweeps of the diffusion and pressure solves. Every variant
+// evaluates the same expressions in the same order without fused
+// multiply-adds, so all of them produce bit-identical results.
+struct AdvectKernels
+{
+    SimdLevel level;
+    const char *name;
+
+    // dest[j] = source sampled at (i + scale * u[j], j + scale * v[j]) for j
+    // in [jBegin, jEnd). u, v and dest point at row i of their fields.
+    void (*traceRow)(float *dest, FieldView source, const float *u, const float *v,
+                     int i, int jBegin, int jEnd, float scale);
+
+    // dest[j] = source sampled at the start of the RK4 back-trace through the
+    // velocity field (u, v) over dt0 grid cells, for j in [jBegin, jEnd)
+    void (*rk4Row)(float *dest, FieldView source, FieldView u, FieldView v,
+                   int i, int jBegin, int jEnd, float dt0);
+
+    // Largest |u[j]| or |v[j]| for j in [jBegin, jEnd), at least 0
+    float (*maxSpeedRow)(const float *u, const float *v, int jBegin, int jEnd);
+
+    // traceRow and rk4Row sampling a source and velocity stored in any
+    // layout. u and v are whole fields; traceRowStored reads them along rows,
+    // and for rk4RowStored they are blocked exactly when the source is.
+    void (*traceRowStored)(float *dest, StorageView source, StorageView u, StorageView v,
+                           int i, int jBegin, int jEnd, float scale);
+    void (*rk4RowStored)(float *dest, StorageView source, StorageView u, StorageView v,
+                         int i, int jBegin, int jEnd, float dt0);
+
+    // dest[k] = source[k] rounded to nearest even in precision, which is
+    // Float16 or BFloat16, for k in [0, count)
+    void (*narrowRow)(std::uint16_t *dest, const float *source, int count, StoragePrecision precision);
+
+    // dest[k] = sqrt(u[k] * u[k] + v[k] * v[k]) for k in [0, count)
+    void (*speedRow)(float *dest, const float *u, const float *v, int count);
+
+    // 3D counterparts of traceRow and rk4Row, along the line of cells
+    // (i, j, k) for k in [kBegin, kEnd); u, v, w and dest point at that line
+    void (*traceLine)(float *dest, VolumeView source, const float *u, const float *v, const float *w,
+                      int i, int j, int kBegin, int kEnd, float scale);
+    void (*rk4Line)(float *dest, VolumeView source, VolumeView u, VolumeView v, VolumeView w,
+                    int i, int j, int kBegin, int kEnd, float dt0);
+
+    // Red-black relaxation of the cells k = kBegin, kBegin + 2, ... below kEnd
+    // of a 2D row or 3D line x, whose neighbours across the other axes are
+    // the neighbourCount lines in neighbours. With s = the sum of those
+    // neighbours' cells k, then x[k + 1] and x[k - 1], sorLine moves x[k]
+    // omega of the way to (b[k] + a * s) * cRecip, and gaussSeidelLine sets
+    // it to (b[k] + s) / divisor. Only cells of one color are written, so
+    // lines of one half-sweep can be relaxed in parallel.
+    void (*sorLine)(float *x, const float *b, const float *const *neighbours, int neighbourCount,
+                    int kBegin, int kEnd, float a, float cRecip, float omega);
+    void (*gaussSeidelLine)(float *x, const float *b, const float *const *neighbours, int neighbourCount,
+                            int kBegin, int kEnd, float divisor);
+};
+
+// Highest instruction set supported by both this build and the running CPU
+SimdLevel bestSimdLevel();
+
+// Kernels for the requested level, falling back to the best available one
+// when the build or the CPU lacks it
+const AdvectKernels &getAdvectKernels(SimdLevel level);
+
+#endif // ADVECT_KERNELS_H
@@ -0,0 +1,78 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "field.h"
+
+const std::uint32_t CHECKPOINT_VERSION = 2;
+const std::uint32_t CHECKPOINT_BYTE_ORDER = 0x01020304;
+
+// Fields stored in a snapshot, in file order
+enum class CheckpointField
+{
+    Density,
+    VelocityX,
+    VelocityY,
+    DiffusedPressure, // Last pressure of each projection, which a warm
+    AdvectedPressure, // start continues from
+    Count
+};
+
+const int CHECKPOINT_FIELD_COUNT = static_cast<int>(CheckpointField::Count);
+
+// First 64 bytes of a snapshot file. Values are in the writer's byte order,
+// which byteOrder records. Field k starts at fieldOffset + k * fieldBytes,
+// both multiples of FIELD_ALIGNMENT, and holds the field's storage exactly
+// as in memory: width rows of stride floats, ghost cells included.
+struct CheckpointHeader
+{
+    char magic[8]; // "FLUIDCKP"
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::int32_t width, height;
+    std::int32_t stride;
+    std::uint32_t fieldCount;
+    std::uint64_t fieldOffset;
+    std::uint64_t fieldBytes;
+    std::uint64_t stepCount; // FluidSim::getStepCount() when saved
+    std::uint32_t noiseSeed;
+    std::uint32_t noiseStep; // Position in the noise sequence
+};
+
+static_assert(sizeof(CheckpointHeader) == FIELD_ALIGNMENT, "Checkpoint header must fill one alignment unit");
+
+// Header for a snapshot of width x height fields with the given row
+// stride, packed directly after the header; the caller fills in the step and
+// noise state
+CheckpointHeader makeCheckpointHeader(int width, int height, int stride);
+
+// Write a snapshot to path, replacing any existing file only once the new
+// one is complete. Throws std::runtime_error on I/O failure.
+void writeCheckpoint(const std::string &path, const CheckpointHeader &header, const FieldView *fields);
+
+// Read-only snapshot mapped into memory. The field views point straight
+// into the mapping, so opening a snapshot costs no copies and pages are
+// read on first touch. Throws std::runtime_error if the file cannot be
+// mapped or is not a CHECKPOINT_VERSION snapshot written with this byte order.
+class Checkpoint
+{
+public:
+    explicit Checkpoint(const std::string &path);
+    ~Checkpoint();
+
+    Checkpoint(const Checkpoint &) = delete;
+    Checkpoint &operator=(const Checkpoint &) = delete;
+
+    const CheckpointHeader &getHeader() const { return *static_cast<const CheckpointHeader *>(mapping); }
+
+    // Valid while this Checkpoint lives
+    FieldView getField(CheckpointField field) const;
+
+private:
+    void *mapping = nullptr;
+    std::size_t mappingSize = 0;
+};
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,84 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "field_recorder.h"
+#include "fluid_sim.h"
+#include "work_stealing_scheduler.h"
+
+// One simulation of an ensemble: its grid, parameters and run length
+struct EnsembleMember
+{
+    int width = GRID_SIZE_X, height = GRID_SIZE_Y;
+    float viscosity = VISCOSITY;
+    float diffusion = DIFFUSION;
+    AdvectionScheme velocityScheme = AdvectionScheme::RK4;
+    AdvectionScheme densityScheme = AdvectionScheme::RK4;
+    PressureSolver solver = PressureSolver::GaussSeidel;
+    TimestepSettings timestep;
+    std::uint32_t seed = 0; // Velocity noise seed
+    float dt = 0.01f;
+    int steps = 100;
+
+    std::string checkpointPath; // Start from this snapshot instead of an empty grid
+    std::string recordPath;     // Record the run here when set
+    RecorderSettings recorder;
+};
+
+// Summary of one finished member
+struct EnsembleResult
+{
+    bool ok = false;
+    std::string error; // Why the member failed, when it did
+
+    double seconds = 0.0;
+    long long steps = 0;
+    double totalDensity = 0.0;  // Over the interior cells at the end
+    double kineticEnergy = 0.0; // Sum of (u^2 + v^2) / 2 over the interior cells
+    float maxSpeed = 0.0f;      // Largest velocity component
+    long long recordedFrames = 0;
+    SimStats stats;
+};
+
+// Runs batches of independent simulations with per-member parameters.
+//
+// Members are spread over the workers of a WorkStealingScheduler, one member
+// per worker at a time. Each worker keeps a single-threaded FluidSim and
+// reuses it, with its fields and solver scratch, for every member it runs;
+// only a change of grid size reallocates. A batch therefore costs no thread
+// or allocation per member, and parallelism comes from running members side
+// by side, so batches should hold at least as many members as workers.
+class EnsembleRunner
+{
+public:
+    // Initial conditions for member index, applied after the grid is
+    // cleared or loaded and before the first step
+    typedef std::function<void(FluidSim &, int)> Setup;
+    // Forcing for member index before each step, given the step number
+    typedef std::function<void(FluidSim &, int, int)> Force;
+
+    // workerCount includes the calling thread; 0 selects one per hardware core
+    explicit EnsembleRunner(int workerCount = 0);
+
+    int getWorkerCount() const { return scheduler.getWorkerCount(); }
+
+    // Run every member and wait; results are in member order. A member that
+    // fails (say, an unreadable checkpoint) reports its error without
+    // stopping the others.
+    std::vector<EnsembleResult> run(const std::vector<EnsembleMember> &members, const Setup &setup = Setup(),
+                                    const Force &force = Force());
+
+    long long getStealCount() const { return scheduler.getStealCount(); }
+
+private:
+    WorkStealingScheduler scheduler;
+    std::vector<std::unique_ptr<FluidSim>> sims; // One per worker
+
+    void runMember(FluidSim &sim, const EnsembleMember &member, int index, const Setup &setup, const Force &force,
+                   EnsembleResult &result);
+};
+
+#endif // ENSEMBLE_H
@@ -0,0 +1,100 @@
+#ifndef FIELD_H
+#define FIELD_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+
+// Alignment of every field allocation (one cache line)
+const std::size_t FIELD_ALIGNMENT = 64;
+
+// Arrangement of field cells in memory. Field holds the two row layouts;
+// the advectors can also gather from copies in the blocked orders (see
+// FluidSim::setFieldLayout).
+enum class FieldLayout
+{
+    Rows,       // [x][y], consecutive rows back to back
+    PaddedRows, // Rows padded to whole cache lines, with strides that map
+                // consecutive rows to different cache sets
+    Tiled,      // 8x8 tiles in row order, cells in row order within a tile
+    Morton      // 32x32 blocks in row order, cells in Z-order within a block
+};
+
+// Distance in floats between consecutive rows of a field of the given
+// height stored in Rows or PaddedRows
+int rowStride(int height, FieldLayout layout);
+
+// Read-only view of a field's storage: cell (x, y) is
+// data[(x - firstRow) * stride + y]. A view with firstRow > 0 covers only
+// some rows of a width x height grid; readers must stay inside them.
+// Plain data with no member functions, so it can be handed to kernels built
+// with different instruction-set flags.
+struct FieldView
+{
+    const float *data;
+    int width, height;
+    int stride;
+    int firstRow;
+};
+
+// Scalar grid field stored contiguously on the heap in [x][y] order:
+// all cells sharing an x index form one row in memory.
+class Field
+{
+public:
+    Field() = default;
+    Field(int width, int height);
+
+    Field(Field &&) = default;
+    Field &operator=(Field &&) = default;
+
+    // (Re)allocate storage for the given size; contents are zeroed. layout
+    // is Rows or PaddedRows.
+    void resize(int width, int height, FieldLayout layout = FieldLayout::Rows);
+
+    void fill(float value);
+    // Copy the cells of another field, resizing to it if needed. A field
+    // that has to be resized takes other's layout, but keeps its own when
+    // copying a view.
+    void copyFrom(const Field &other);
+    // Copy a full view (firstRow 0) of another field's storage
+    void copyFrom(const FieldView &source);
+
+    float &operator()(int x, int y) { return storage[static_cast<std::size_t>(x) * stride + y]; }
+    float operator()(int x, int y) const { return storage[static_cast<std::size_t>(x) * stride + y]; }
+
+    float *data() { return storage.get(); }
+    const float *data() const { return storage.get(); }
+    float *row(int x) { return storage.get() + static_cast<std::size_t>(x) * stride; }
+    const float *row(int x) const { return storage.get() + static_cast<std::size_t>(x) * stride; }
+
+    FieldView view() const { return {storage.get(), width, height, stride, 0}; }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getStride() const { return stride; }
+    FieldLayout getLayout() const { return layout; }
+    std::size_t getSize() const { return static_cast<std::size_t>(width) * stride; }
+
+private:
+    struct AlignedDeleter
+    {
+        void operator()(float *p) const { std::free(p); }
+    };
+
+    int width = 0, height = 0;
+    int stride = 0; // Distance in floats between consecutive rows
+    FieldLayout layout = FieldLayout::Rows;
+    std::unique_ptr<float[], AlignedDeleter> storage;
+};
+
+// Fill the ghost cells on the outer walls of a field. b selects the
+// component: 0 for scalars, 1 for x velocity and 2 for y velocity, which are
+// mirrored with opposite sign so the walls are impermeable.
+void applyBoundary(int b, Field &x);
+
+// Same with the component fixed at compile time; instantiated for B = 0, 1, 2
+template <int B>
+void applyBoundary(Field &x);
+
+#endif // FIELD_H
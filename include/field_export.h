@@ -0,0 +1,39 @@
+#ifndef FIELD_EXPORT_H
+#define FIELD_EXPORT_H
+
+#include "advect_kernels.h"
+#include "field.h"
+#include "storage_precision.h"
+
+// Cells (x, y) with x in [x, x + width) and y in [y, y + height)
+struct FieldRegion
+{
+    int x = 0, y = 0;
+    int width = 0, height = 0;
+};
+
+// Every cell of a field
+inline FieldRegion wholeField(const FieldView &field) { return {0, 0, field.width, field.height}; }
+
+// Arrangement of an exported region in the caller's buffer, with (x, y)
+// relative to the region's corner and pitch in elements
+enum class ExportOrder
+{
+    Native,    // dest[x * pitch + y], the fields' own [x][y] order
+    Transposed // dest[y * pitch + x], image order with x along each row
+};
+
+// Bulk copy of a field region into a caller buffer, converted to precision
+// (float for Float32, 16-bit words otherwise), by the SIMD kernels of the
+// given level. The view must cover the region's rows; throws
+// std::invalid_argument when it does not or when pitch is too small.
+void exportField(const FieldView &field, const FieldRegion &region, void *dest, int pitch,
+                 StoragePrecision precision = StoragePrecision::Float32, ExportOrder order = ExportOrder::Native,
+                 SimdLevel level = bestSimdLevel());
+
+// Same for the speed sqrt(u^2 + v^2) of a velocity field
+void exportSpeed(const FieldView &u, const FieldView &v, const FieldRegion &region, void *dest, int pitch,
+                 StoragePrecision precision = StoragePrecision::Float32, ExportOrder order = ExportOrder::Native,
+                 SimdLevel level = bestSimdLevel());
+
+#endif // FIELD_EXPORT_H
@@ -0,0 +1,147 @@
+#ifndef FIELD_RECORDER_H
+#define FIELD_RECORDER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "fluid_sim.h"
+#include "lz_codec.h"
+#include "simulation_thread.h"
+#include "spsc_queue.h"
+
+const std::uint32_t RECORDING_VERSION = 1;
+const std::uint32_t RECORDING_BYTE_ORDER = 0x01020304;
+const int RECORDING_FIELD_COUNT = 3; // Density, velocity x, velocity y
+
+// Start of a recording file. Values are in the writer's byte order.
+struct RecordingHeader
+{
+    char magic[8]; // "FLUIDREC"
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::int32_t width, height;
+    std::uint32_t bits;             // Per quantised value, 8 or 16
+    std::uint32_t keyframeInterval; // Recorded frames from one keyframe to the next
+};
+
+// Precedes each frame's compressed payload. A field's values are
+// minimum + code * scale, with codes in 0 .. 2^bits - 1.
+struct RecordedFrameHeader
+{
+    std::uint64_t step;
+    std::uint32_t keyframe; // Nonzero if coded without reference to the previous frame
+    std::uint32_t compressedBytes;
+    float minimum[RECORDING_FIELD_COUNT];
+    float scale[RECORDING_FIELD_COUNT];
+};
+
+struct RecorderSettings
+{
+    int interval = 1;          // Record every interval-th frame offered
+    int bits = 8;              // Quantisation of each value, 8 or 16
+    int keyframeInterval = 60; // Recorded frames between keyframes, which playback can start from
+    int queueFrames = 8;       // Frames waiting for the writer before further ones are dropped
+};
+
+// Streams density and velocity frames to disk. offer() only copies the
+// fields into a preallocated slot and queues it; quantisation, delta
+// coding, compression and the write happen on a writer thread of its own.
+//
+// Each field, ghost cells included, is quantised over its own range, then
+// stored as the difference from the previous frame's codes (modulo 2^bits,
+// zigzag coded so small changes either way are small numbers) split into
+// byte planes. Still regions become long zero runs, which LzCompressor
+// collapses. Keyframes are coded against zero.
+class FieldRecorder
+{
+public:
+    // Create the file and start the writer; throws std::runtime_error if
+    // the file cannot be created or the settings are invalid
+    FieldRecorder(const std::string &path, int width, int height, const RecorderSettings &settings = RecorderSettings());
+    ~FieldRecorder();
+
+    FieldRecorder(const FieldRecorder &) = delete;
+    FieldRecorder &operator=(const FieldRecorder &) = delete;
+
+    // From a single producer thread. Queues every interval-th call; false if
+    // that frame was dropped because the writer is behind.
+    bool offer(const FluidSim &sim);
+    bool offer(const FieldView &density, const FieldView &velocityX, const FieldView &velocityY, std::uint64_t step);
+
+    // Write out every queued frame and close the file; throws
+    // std::runtime_error if any write failed
+    void close();
+
+    long long getRecordedCount() const { return recorded; }
+    long long getDroppedCount() const { return dropped; }
+    std::uint64_t getBytesWritten() const { return bytesWritten; }
+
+private:
+    struct Slot
+    {
+        Field fields[RECORDING_FIELD_COUNT];
+        std::uint64_t step = 0;
+    };
+
+    RecorderSettings settings;
+    int width, height;
+    std::ofstream out;
+
+    // Slots cycle from free to ready (producer) and back (writer)
+    std::vector<Slot> slots;
+    SpscQueue<int> freeSlots;
+    SpscQueue<int> readySlots;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::atomic<bool> running{true};
+    std::atomic<bool> failed{false};
+    std::thread writer;
+
+    long long offered = 0;
+    std::atomic<long long> recorded{0};
+    std::atomic<long long> dropped{0};
+    std::atomic<std::uint64_t> bytesWritten{0};
+
+    // Writer state
+    std::vector<std::uint16_t> previousCodes;
+    std::vector<std::uint8_t> planes;
+    std::vector<std::uint8_t> compressed;
+    LzCompressor compressor;
+    long long framesSinceKeyframe = 0;
+
+    void run();
+    void writeFrame(const Slot &slot);
+};
+
+// Streams the frames of a recording back in order, one decoded frame at a
+// time. Throws std::runtime_error on a missing, foreign or corrupt file.
+class RecordingReader
+{
+public:
+    explicit RecordingReader(const std::string &path);
+
+    const RecordingHeader &getHeader() const { return header; }
+    int getWidth() const { return header.width; }
+    int getHeight() const { return header.height; }
+
+    // Decode the next frame into frame's fields; false after the last one
+    bool next(SimFrame &frame);
+
+    // Return to the first frame
+    void rewind();
+
+private:
+    RecordingHeader header;
+    std::ifstream in;
+    std::streampos firstFrame;
+    std::vector<std::uint16_t> previousCodes;
+    std::vector<std::uint8_t> planes;
+    std::vector<std::uint8_t> compressed;
+};
+
+#endif // FIELD_RECORDER_H
@@ -6,26 +6,144 @@
 #include <cmath>
 #include <algorithm>
 #include <memory>
+#include <array>
+#include <string>
+#include "field.h"
+#include "multigrid.h"
+#include "noise.h"
+#include "obstacle_mask.h"
+#include "pcg.h"
+#include "sim_stats.h"
+#include "solver_stats.h"
+#include "splat.h"
+#include "thread_pool.h"
+#include "tile_mask.h"
+#include "advect_kernels.h"
+#include "checkpoint.h"
+#include "storage_precision.h"
 
 // Grid-based Eulerian fluid simulation parameters
+// Default grid resolution; any size can be chosen at runtime
 const int GRID_SIZE_X = 200;
 const int GRID_SIZE_Y = 200;
+// Default viscosity and density diffusion; each FluidSim can set its own
 const float VISCOSITY = 0.0001f;
 const float DIFFUSION = 0.0f;
 const float PRESSURE = 0.5f;
 
+// Advection schemes available to FluidSim::advect
+enum class AdvectionScheme
+{
+    SemiLagrangian, // Fastest, most diffusive
+    MacCormack,     // Good balance of accuracy and performance
+    RK4             // Highest accuracy, slower
+};
+
+// Adaptive splitting of FluidSim::step into substeps
+struct TimestepSettings
+{
+    bool adaptive = false;  // Off: every step() is one substep of the given dt
+    float targetCfl = 1.0f; // Largest distance in cells the fluid may move per substep
+    int maxSubsteps = 8;    // Cap on the split; beyond it the advectors clamp
+};
+
+// Skipping of still, empty regions in diffusion and advection. Each substep
+// marks the TileMask::TILE_SIZE square tiles holding density or velocity
+// above the thresholds, grows that region by the distance the flow can
+// travel, and leaves the remaining tiles untouched. The pressure solve
+// always covers the whole grid.
+struct SparseSettings
+{
+    bool enabled = false;
+    float densityThreshold = 1e-4f;
+    float velocityThreshold = 1e-3f; // Above the default velocity noise
+};
+
+// Quantities advected by FluidSim, each with its own scheme
+enum class AdvectedField
+{
+    Velocity,
+    Density
+};
+
+// Solvers available for the pressure Poisson equation in FluidSim::project
+enum class PressureSolver
+{
+    GaussSeidel,      // In-place sweeps (RelaxationSettings), cheap but converges slowly
+    Multigrid,        // Geometric multigrid, convergence independent of resolution
+    ConjugateGradient // Preconditioned CG, stops at a residual tolerance
+};
+// Multigrid has no obstacles on its coarse levels, so ConjugateGradient runs
+// in its place while any cell is solid
+
+// Convergence control of the relaxation sweeps FluidSim runs for diffusion
+// and for the Gauss-Seidel pressure solve. With a tolerance set, the residual
+// (max norm relative to the right-hand side, absolute when that is zero) is
+// measured before the first sweep and every checkInterval sweeps, each check
+// costing about a sweep, and the solve stops once it is at or below the
+// tolerance. A zero tolerance runs all maxIterations sweeps unmeasured.
+struct RelaxationSettings
+{
+    int maxIterations = 20;
+    float tolerance = 0.0f;
+    int checkInterval = 4;
+};
+
 class FluidSim
 {
 public:
-    FluidSim();
+    // threadCount includes the calling thread; 0 uses every hardware core
+    FluidSim(int width = GRID_SIZE_X, int height = GRID_SIZE_Y, int threadCount = 0);
     void step(float dt);
 
+    // Clear all fields in place without reallocating
+    void reset();
+    // Reallocate the grid at a new resolution (contents are cleared)
+    void resize(int width, int height);
+
+    // Binary snapshots of the grid, step counter and noise position (see
+    // checkpoint.h). The grid includes both pressure fields, so a run with
+    // warm-started pressure solves resumes bit-identically. Loading resizes
+    // the grid to the snapshot's; settings, including noise amplitude, are
+    // kept, apart from the noise seed.
+    void saveCheckpoint(const std::string &path) const;
+    void loadCheckpoint(const Checkpoint &checkpoint);
+    void loadCheckpoint(const std::string &path);
+
+    // Steps taken since construction, reset() or resize()
+    std::uint64_t getStepCount() const { return stepCount; }
+
     // Methods for interacting with the fluid
     void addDensity(int x, int y, float amount);
     void addVelocity(int x, int y, float amountX, float amountY);
 
+    // Queue a splat, added once at the start of the next step. All splats
+    // and emitters of a step are applied together in one pass over the
+    // tiles they reach, so many small inputs cost little more than one.
+    void addSplat(const Splat &splat) { pendingSplats.push_back(splat); }
+    // Persistent source applied at the start of every step, its amounts
+    // scaled by the step's dt; returns an id for removeEmitter. Emitters are
+    // settings like the obstacles: reset() and resize() keep them, while
+    // queued splats are dropped.
+    int addEmitter(const Splat &rate);
+    void removeEmitter(int id);
+    void clearEmitters() { emitters.clear(); }
+
+    // Solid cells inside the box, all fluid after construction and resize()
+    // and kept by reset(). Edits take effect at the start of the next step,
+    // which rebuilds the mask's boundary lists and sets the cells that became
+    // solid as walls; solid cells are not stored in checkpoints.
+    ObstacleMask &getObstacles() { return obstacles; }
+    const ObstacleMask &getObstacles() const { return obstacles; }
+
     // Methods to access grid data for rendering
     float getDensity(int x, int y) const;
+    // Direct views of the field storage, valid until the next resize(); use
+    // these rather than the per-cell getters to read whole fields, or
+    // exportField/exportSpeed (field_export.h) for converted copies
+    FieldView getDensityView() const { return density.view(); }
+    FieldView getVelocityXView() const { return velocityX.view(); }
+    FieldView getVelocityYView() const { return velocityY.view(); }
     glm::vec2 getVelocity(int x, int y) const;
 
     // Velocity visualization methods
@@ -36,42 +154,209 @@ public:
     int getWidth() const { return width; }
     int getHeight() const { return height; }
 
+    // Velocity viscosity and density diffusion rates
+    void setViscosity(float value) { viscosity = value; }
+    float getViscosity() const { return viscosity; }
+    void setDiffusion(float value) { diffusion = value; }
+    float getDiffusion() const { return diffusion; }
+
+    // Instruction set of the advection and relaxation kernels; defaults to the
+    // best one the CPU supports, requests above that fall back to it
+    void setSimdLevel(SimdLevel level);
+    SimdLevel getSimdLevel() const { return advectKernels->level; }
+
+    // Replace the worker pool that runs the solver kernels
+    void setThreadCount(int threadCount);
+    int getThreadCount() const;
+
+    // Advection scheme per advected field; the one-argument form sets both.
+    // Takes effect from the next step, so quality can be lowered under load.
+    void setAdvectionScheme(AdvectionScheme scheme);
+    void setAdvectionScheme(AdvectedField field, AdvectionScheme scheme);
+    AdvectionScheme getAdvectionScheme(AdvectedField field) const;
+
+    // Memory layout of the fields, Rows by default. Rows and PaddedRows set
+    // the stride of every grid field, keeping the contents. Tiled and Morton
+    // keep the fields in padded rows, which the stencil solvers stream along,
+    // and have the advectors gather from copies in that order made before
+    // each advection; they also apply to the velocity RK4 samples, and cost
+    // one pass per copy.
+    void setFieldLayout(FieldLayout layout);
+    FieldLayout getFieldLayout() const { return fieldLayout; }
+
+    // Velocity noise; the sequence restarts from the seed on reset() and
+    // resize(), so runs are reproducible
+    void setNoiseSettings(const NoiseSettings &settings) { noiseSettings = settings; }
+    const NoiseSettings &getNoiseSettings() const { return noiseSettings; }
+
+    // Substepping of step(dt) from the CFL number of the current velocity
+    void setTimestepSettings(const TimestepSettings &settings) { timestepSettings = settings; }
+    const TimestepSettings &getTimestepSettings() const { return timestepSettings; }
+    // Substeps the most recent step() was split into
+    int getSubstepCount() const { return substepCount; }
+
+    // Tile skipping, and the tiles the most recent substep worked on
+    void setSparseSettings(const SparseSettings &settings) { sparseSettings = settings; }
+    const SparseSettings &getSparseSettings() const { return sparseSettings; }
+    const TileMask &getActiveTiles() const { return activeTiles; }
+
+    // Solver used for the pressure projection
+    void setPressureSolver(PressureSolver solver) { pressureSolver = solver; }
+    PressureSolver getPressureSolver() const { return pressureSolver; }
+    void setMultigridSettings(const MultigridSettings &settings) { multigridSettings = settings; }
+    const MultigridSettings &getMultigridSettings() const { return multigridSettings; }
+    void setPcgSettings(const PcgSettings &settings) { pcgSettings = settings; }
+    const PcgSettings &getPcgSettings() const { return pcgSettings; }
+    void setGaussSeidelSettings(const RelaxationSettings &settings) { gaussSeidelSettings = settings; }
+    const RelaxationSettings &getGaussSeidelSettings() const { return gaussSeidelSettings; }
+
+    // Start each pressure solve from the pressure the same projection found
+    // in the previous substep instead of from zero, so a steady flow needs
+    // few iterations to meet a tolerance. Multigrid then skips its FMG pass
+    // and only runs its V-cycles. Off by default; the kept pressure is
+    // cleared by reset() and resize(), and restored by loadCheckpoint().
+    void setPressureWarmStart(bool enabled) { pressureWarmStart = enabled; }
+    bool getPressureWarmStart() const { return pressureWarmStart; }
+
+    // Sweeps of the SOR diffusion solve, 5 by default
+    void setDiffusionSettings(const RelaxationSettings &settings) { diffusionSettings = settings; }
+    const RelaxationSettings &getDiffusionSettings() const { return diffusionSettings; }
+
+    // Pressure solves of the most recent step: iterations summed over both
+    // projections, residual of the worse one
+    const SolverStats &getPressureStats() const { return pressureStats; }
+    // Same for the three diffusion solves of the most recent step
+    const SolverStats &getDiffusionStats() const { return diffusionStats; }
+
+    // Per-stage times, calls and cells plus pressure solver totals,
+    // accumulated since construction or resetStats()
+    const SimStats &getStats() const { return stats; }
+    void resetStats() { stats = SimStats(); }
+
+    // Span log of every instrumented stage, idle until started
+    TraceRecorder &getTrace() { return trace; }
+
 private:
     // Grid properties
-    int width, height;
-    float density[GRID_SIZE_X][GRID_SIZE_Y];
-    float velocityX[GRID_SIZE_X][GRID_SIZE_Y];
-    float velocityY[GRID_SIZE_X][GRID_SIZE_Y];
-
-    // Temporary arrays for simulation steps
-    float prevDensity[GRID_SIZE_X][GRID_SIZE_Y];
-    float prevVelocityX[GRID_SIZE_X][GRID_SIZE_Y];
-    float prevVelocityY[GRID_SIZE_X][GRID_SIZE_Y];
-    
-    // Additional temporary arrays for MacCormack advection
-    float tempField1[GRID_SIZE_X][GRID_SIZE_Y];
-    float tempField2[GRID_SIZE_X][GRID_SIZE_Y];
+    int width = 0, height = 0;
+    float viscosity = VISCOSITY;
+    float diffusion = DIFFUSION;
+    AdvectionScheme velocityScheme = AdvectionScheme::RK4;
+    AdvectionScheme densityScheme = AdvectionScheme::RK4;
+    FieldLayout fieldLayout = FieldLayout::Rows;
+    PressureSolver pressureSolver = PressureSolver::GaussSeidel;
+    NoiseSettings noiseSettings;
+    TimestepSettings timestepSettings;
+    int substepCount = 1;
+    SparseSettings sparseSettings;
+    TileMask activeTiles;
+    std::vector<float> tileSpeeds;
+    ObstacleMask obstacles;
+    std::uint32_t noiseStep = 0;
+    std::uint64_t stepCount = 0;
+    MultigridSettings multigridSettings;
+    MultigridSolver multigrid;
+    PcgSettings pcgSettings;
+    ConjugateGradientSolver conjugateGradient;
+    RelaxationSettings gaussSeidelSettings;
+    RelaxationSettings diffusionSettings = {5, 0.0f, 4};
+    bool pressureWarmStart = false;
+    SolverStats pressureStats;
+    SolverStats diffusionStats;
+    SimStats stats;
+    TraceRecorder trace;
+    std::unique_ptr<ThreadPool> threadPool;
+    const AdvectKernels *advectKernels = &getAdvectKernels(bestSimdLevel());
+    Field density;
+    Field velocityX;
+    Field velocityY;
+
+    // Temporary fields for simulation steps
+    Field prevDensity;
+    Field prevVelocityX;
+    Field prevVelocityY;
+
+    // Pressure of the projections after diffusion and after advection, kept
+    // between substeps for warm starts
+    Field diffusedPressure;
+    Field advectedPressure;
+
+    // Per-thread predictor windows for MacCormack advection
+    std::vector<Field> macCormackWindows;
+
+    // Queued splats, emitters, the tiles the current batch of them reaches
+    // and the rasterizer's scratch weights
+    struct Emitter
+    {
+        int id;
+        Splat rate;
+    };
+    std::vector<Splat> pendingSplats;
+    std::vector<Emitter> emitters;
+    int nextEmitterId = 0;
+    TileMask splatTiles;
+    std::vector<float> splatWeights;
+
+    // Blocked copies sampled by the advectors, allocated on first
+    // use. The velocity sources are the blocked copies of velocity as the
+    // advected quantity, needed when the back-traces read it along rows.
+    SampleField densitySamples;
+    SampleField velocitySamplesX;
+    SampleField velocitySamplesY;
+    SampleField velocitySourcesX;
+    SampleField velocitySourcesY;
+
+    // What the advectors sample: views of the source and velocity fields
+    // passed to them, or of copies of those
+    struct AdvectSamples
+    {
+        StorageView source, u, v;
+        bool copied; // Any of them a copy, so the blocked-layout kernels run
+    };
 
     // Simulation methods
-    void addSource(float dest[GRID_SIZE_X][GRID_SIZE_Y], const float source[GRID_SIZE_X][GRID_SIZE_Y], float dt);
-    void diffuse(int b, float dest[GRID_SIZE_X][GRID_SIZE_Y], const float source[GRID_SIZE_X][GRID_SIZE_Y], float diff, float dt);
-    
-    // Main advection method - delegates to specific implementation
-    void advect(int b, float dest[GRID_SIZE_X][GRID_SIZE_Y], const float source[GRID_SIZE_X][GRID_SIZE_Y], const float u[GRID_SIZE_X][GRID_SIZE_Y], const float v[GRID_SIZE_X][GRID_SIZE_Y], float dt);
+    void addSource(Field &dest, const Field &source, const TileMask &tiles);
+    void applySplats(float dt);
+    void updateObstacles();
+    void diffuse(int b, Field &dest, const Field &source, float diff, float dt);
     
-    // Specific advection implementations:
-    void macCormackAdvect(int b, float dest[GRID_SIZE_X][GRID_SIZE_Y], const float source[GRID_SIZE_X][GRID_SIZE_Y], const float u[GRID_SIZE_X][GRID_SIZE_Y], const float v[GRID_SIZE_X][GRID_SIZE_Y], float dt);    // Good balance of accuracy and performance
-    void rk4Advect(int b, float dest[GRID_SIZE_X][GRID_SIZE_Y], const float source[GRID_SIZE_X][GRID_SIZE_Y], const float u[GRID_SIZE_X][GRID_SIZE_Y], const float v[GRID_SIZE_X][GRID_SIZE_Y], float dt);           // Highest accuracy, slower
-    void semiLagrangianAdvect(int b, float dest[GRID_SIZE_X][GRID_SIZE_Y], const float source[GRID_SIZE_X][GRID_SIZE_Y], const float u[GRID_SIZE_X][GRID_SIZE_Y], const float v[GRID_SIZE_X][GRID_SIZE_Y], float dt); // Fastest, most diffusive
-    
-    void project(float u[GRID_SIZE_X][GRID_SIZE_Y], float v[GRID_SIZE_X][GRID_SIZE_Y], float p[GRID_SIZE_X][GRID_SIZE_Y], float div[GRID_SIZE_X][GRID_SIZE_Y]);
-    void setBoundary(int b, float x[GRID_SIZE_X][GRID_SIZE_Y]);
-    
-    // Helper methods
-    float bilinearInterpolate(const float field[GRID_SIZE_X][GRID_SIZE_Y], float x, float y) const;
-    glm::vec2 getVelocityAt(const float u[GRID_SIZE_X][GRID_SIZE_Y], const float v[GRID_SIZE_X][GRID_SIZE_Y], float x, float y) const;
+    // Main advection method - delegates to the implementation specialized
+    // for the scheme and boundary type b
+    void advect(AdvectionScheme scheme, int b, Field &dest, const Field &source, const Field &u, const Field &v,
+                const AdvectSamples &samples, float dt);
 
+    // Specific advection implementations, one instantiation per boundary type:
+    // Good balance of accuracy and performance
+    template <int B>
+    void macCormackAdvect(Field &dest, const Field &source, const Field &u, const Field &v,
+                          const AdvectSamples &samples, float dt);
+    // Highest accuracy, slower
+    template <int B>
+    void rk4Advect(Field &dest, const Field &source, const Field &u, const Field &v,
+                   const AdvectSamples &samples, float dt);
+    // Fastest, most diffusive
+    template <int B>
+    void semiLagrangianAdvect(Field &dest, const Field &source, const Field &u, const Field &v,
+                              const AdvectSamples &samples, float dt);
+
+    // Table of the above indexed by [scheme][b]
+    typedef void (FluidSim::*AdvectMethod)(Field &, const Field &, const Field &, const Field &, const AdvectSamples &,
+                                           float);
+    static const AdvectMethod ADVECT_METHODS[3][3];
+
+    void project(Field &u, Field &v, Field &p, Field &div);
+    void setBoundary(int b, Field &x);
+    template <int B>
+    void setBoundary(Field &x);
+    
     // Helper methods
+    std::array<Field *, 8> gridFields();
+    void updateActiveTiles(float dt);
+    float maxSpeed(const Field &u, const Field &v);
+    FieldLayout rowLayout() const;
+    bool blockedLayout() const;
+    StorageView sampleCopy(const Field &field, SampleField &copy);
+    void addNoise();
     void velocityStep(float dt);
     void densityStep(float dt);
 };
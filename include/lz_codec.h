@@ -0,0 +1,33 @@
+#ifndef LZ_CODEC_H
+#define LZ_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Byte-oriented LZ77 block compressor in the style of LZ4: greedy matches
+// found through a hash table of 4-byte sequences, no entropy coding. Fast
+// enough to keep up with a simulation, and effective on the long zero runs
+// of delta-coded fields.
+//
+// A block is a series of sequences, each a token byte (literal count in the
+// high nibble, match length - 4 in the low nibble, 15 meaning "more bytes
+// follow"), the extra literal count bytes, the literals, a little-endian
+// 16-bit match offset and the extra match length bytes. The last sequence
+// has literals only.
+class LzCompressor
+{
+public:
+    // Replace out with the compressed form of size bytes at in
+    void compress(const std::uint8_t *in, std::size_t size, std::vector<std::uint8_t> &out);
+
+private:
+    static const int HASH_BITS = 14;
+    std::vector<std::uint32_t> table; // Position + 1 of the last sequence per hash, 0 if none
+};
+
+// Expand a block into exactly size bytes at out; false if the block is
+// malformed or does not decode to size bytes
+bool lzDecompress(const std::uint8_t *in, std::size_t inSize, std::uint8_t *out, std::size_t size);
+
+#endif // LZ_CODEC_H
@@ -0,0 +1,67 @@
+#ifndef MULTIGRID_H
+#define MULTIGRID_H
+
+#include "field.h"
+#include "solver_stats.h"
+#include "thread_pool.h"
+#include <vector>
+
+// Tuning parameters for the multigrid pressure solve
+struct MultigridSettings
+{
+    bool fullMultigrid = true; // Start from an FMG pass instead of a zero guess
+    int vCycles = 1;           // V-cycles run after the (optional) FMG pass
+    int preSmooth = 2;         // Red-black Gauss-Seidel sweeps before restriction
+    int postSmooth = 2;        // Red-black Gauss-Seidel sweeps after prolongation
+    int coarseSweeps = 40;     // Sweeps used to solve the coarsest level
+    float tolerance = 0.0f;    // Skip the remaining V-cycles once max|r| <= tolerance * max|rhs|
+};
+
+// Geometric multigrid solver for the pressure Poisson equation
+//
+//     4 p(i, j) - p(i+1, j) - p(i-1, j) - p(i, j+1) - p(i, j-1) = rhs(i, j)
+//
+// on the interior cells of a grid whose outer ring holds ghost cells filled
+// by applyBoundary(0, ...), i.e. a zero-gradient (Neumann) wall. Coarse levels
+// are cell-centred with half the interior resolution and use the same ghost
+// cell boundary, so restriction and prolongation see the walls exactly as
+// the fine level does.
+class MultigridSolver
+{
+public:
+    MultigridSolver() = default;
+
+    // Build the level hierarchy for a fine grid of the given size
+    void resize(int width, int height);
+
+    // Solve for p (ghost cells included) given rhs on the interior cells.
+    // Without the FMG pass p is the initial guess. Iterations counts the FMG
+    // pass and the V-cycles run; the residual is measured after each.
+    SolverStats solve(Field &p, const Field &rhs, const MultigridSettings &settings);
+
+    int getLevelCount() const { return static_cast<int>(levels.size()); }
+
+    // Pool used to split the level sweeps across threads (may be null)
+    void setThreadPool(ThreadPool *pool) { threadPool = pool; }
+
+private:
+    struct Level
+    {
+        Field solution; // Error correction on coarse levels (unused on level 0)
+        Field rhs;      // Restricted residual (unused on level 0)
+        Field residual;
+    };
+
+    std::vector<Level> levels;
+    ThreadPool *threadPool = nullptr;
+
+    void smooth(Field &p, const Field &rhs, int sweeps);
+    void computeResidual(const Field &p, const Field &rhs, Field &residual);
+    float maxAbs(const Field &field);
+    void restrictToCoarse(const Field &fine, Field &coarse);
+    void prolongAdd(const Field &coarse, Field &fine);
+    void solveCoarsest(Field &p, Field &rhs, int sweeps);
+    void vCycle(int level, Field &p, const Field &rhs, const MultigridSettings &settings);
+};
+
+#endif // MULTIGRID_H
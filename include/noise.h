@@ -0,0 +1,42 @@
+#ifndef NOISE_H
+#define NOISE_H
+
+#include <cstdint>
+
+// Random perturbation added to the velocity field at the start of each step
+struct NoiseSettings
+{
+    bool enabled = true;
+    float amplitude = 1e-4f; // Each component is uniform in [-amplitude/2, amplitude/2)
+    int blockSize = 1;       // Cells per side sharing one sample; larger is cheaper and coarser
+    std::uint32_t seed = 0;
+};
+
+// Counter-based random numbers: every value is a pure function of
+// (seed, step, index), so noise can be generated in any order, from any
+// thread, and is reproducible run to run.
+
+// Integer finalizer with good avalanche ("lowbias32", C. Wellons)
+inline std::uint32_t hashMix(std::uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// Key shared by every sample of one step
+inline std::uint32_t noiseKey(std::uint32_t seed, std::uint32_t step)
+{
+    return hashMix(seed ^ hashMix(step + 0x9e3779b9u));
+}
+
+// Uniform float in [-0.5, 0.5) for sample index under key
+inline float hashNoise(std::uint32_t key, std::uint32_t index)
+{
+    return static_cast<float>(hashMix(index ^ key) >> 8) * (1.0f / 16777216.0f) - 0.5f;
+}
+
+#endif // NOISE_H
@@ -0,0 +1,125 @@
+#ifndef OBSTACLE_MASK_H
+#define OBSTACLE_MASK_H
+
+#include "field.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Solid cells inside a grid, one bit per cell with bit y of row x in word
+// x * wordsPerRow + y / 64, the fields' [x][y] order. Only interior cells can
+// be solid; the outer ring stays the box walls.
+//
+// Alongside the bits the mask keeps the runs of solid cells along each row
+// and, per boundary type, the list of solid cells next to fluid with the
+// neighbours each one copies, rebuilt by updateBoundaryCells() after the
+// cells change. Setting the solid cells of a field is then a fill per run and
+// one pass over a list, whatever the shape of the obstacles.
+class ObstacleMask
+{
+public:
+    // Cover a width x height grid with every cell fluid
+    void resize(int width, int height);
+
+    // Make every cell fluid
+    void clear();
+
+    // Set one cell; outer ring and out of range cells are ignored
+    void set(int x, int y, bool solid);
+    bool isSolid(int x, int y) const
+    {
+        return (bits[static_cast<std::size_t>(x) * wordsPerRow + (y >> 6)] >> (y & 63)) & 1;
+    }
+
+    // Set every cell whose centre lies within radius of (x, y)
+    void fillDisc(float x, float y, float radius, bool solid);
+    // Set the cells [x0, x1) x [y0, y1)
+    void fillRect(int x0, int y0, int x1, int y1, bool solid);
+    // Replace the cells with a bitmap in image order, pixels[py * pitch + px]
+    // solid when non-zero, scaled to the grid by nearest sampling
+    void loadBitmap(const unsigned char *pixels, int bitmapWidth, int bitmapHeight, int pitch);
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getSolidCount() const { return solidCount; }
+    bool empty() const { return solidCount == 0; }
+
+    // Cells changed since the boundary lists were last built
+    bool isChanged() const { return changed; }
+    void updateBoundaryCells();
+
+    // Set the solid cells of x for boundary type B from their fluid
+    // neighbours, as applyBoundary<B> sets the walls: a scalar (B == 0) takes
+    // their average, a velocity component (B == 1 for x, 2 for y) the
+    // negated average of the neighbours across faces normal to it, or failing
+    // those a copy of the others. Cells without fluid neighbours are zeroed.
+    template <int B>
+    void apply(Field &x) const
+    {
+        for (const SolidRun &run : solidRuns)
+        {
+            std::fill(x.row(run.x) + run.yBegin, x.row(run.x) + run.yEnd, 0.0f);
+        }
+        for (const BoundaryCell &cell : boundaryCells[B])
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < cell.count; k++)
+            {
+                sum += x(cell.x + cell.offsetX[k], cell.y + cell.offsetY[k]);
+            }
+            x(cell.x, cell.y) = cell.weight * sum;
+        }
+    }
+    void apply(int b, Field &x) const;
+
+    // Call fn(jBegin, jEnd) for each run of fluid cells of row x in
+    // [jMin, jMax); rows without solid cells are one run
+    template <typename Fn>
+    void forEachFluidSpan(int x, int jMin, int jMax, Fn fn) const
+    {
+        if (rowSolidCounts[x] == 0)
+        {
+            if (jMin < jMax)
+                fn(jMin, jMax);
+            return;
+        }
+        const std::uint64_t *row = &bits[static_cast<std::size_t>(x) * wordsPerRow];
+        int j = findCell(row, jMin, jMax, false);
+        while (j < jMax)
+        {
+            int end = findCell(row, j, jMax, true);
+            fn(j, end);
+            j = findCell(row, end, jMax, false);
+        }
+    }
+
+private:
+    // Solid cells [yBegin, yEnd) of row x
+    struct SolidRun
+    {
+        int x, yBegin, yEnd;
+    };
+
+    // Solid cell (x, y) and its value's weighted neighbours
+    struct BoundaryCell
+    {
+        int x, y;
+        int count;
+        float weight; // Applied to the neighbour sum: +-1 / count
+        signed char offsetX[4], offsetY[4];
+    };
+
+    int width = 0, height = 0;
+    int wordsPerRow = 0;
+    int solidCount = 0;
+    bool changed = false;
+    std::vector<std::uint64_t> bits;
+    std::vector<int> rowSolidCounts;
+    std::vector<SolidRun> solidRuns;
+    std::vector<BoundaryCell> boundaryCells[3];
+
+    // First cell of row in [j, end) that is solid, or fluid, else end
+    static int findCell(const std::uint64_t *row, int j, int end, bool solid);
+};
+
+#endif // OBSTACLE_MASK_H
@@ -0,0 +1,69 @@
+#ifndef PCG_H
+#define PCG_H
+
+#include "field.h"
+#include "obstacle_mask.h"
+#include "solver_stats.h"
+#include "thread_pool.h"
+
+enum class Preconditioner
+{
+    Jacobi,            // Diagonal scaling, trivially parallel
+    IncompleteCholesky // Modified IC(0), far fewer iterations
+};
+
+// Tuning parameters for the conjugate gradient pressure solve
+struct PcgSettings
+{
+    Preconditioner preconditioner = Preconditioner::IncompleteCholesky;
+    float tolerance = 1e-4f; // Stop once max|r| <= tolerance * max|rhs|
+    int maxIterations = 200;
+};
+
+// Matrix-free preconditioned conjugate gradient solver for the same pressure
+// Poisson equation as MultigridSolver:
+//
+//     4 p(i, j) - p(i+1, j) - p(i-1, j) - p(i, j+1) - p(i, j-1) = rhs(i, j)
+//
+// with zero-gradient walls. Vectors keep ghost cells filled by
+// applyBoundary(0, ...), which makes the 5-point stencil equal to the
+// symmetric operator whose diagonal counts the interior neighbours.
+//
+// With an obstacle mask set, solid cells drop out of the system: they stay
+// at zero in every work vector, and fluid cells count only their fluid
+// neighbours, which puts a zero-gradient wall on each solid face as well.
+class ConjugateGradientSolver
+{
+public:
+    ConjugateGradientSolver() = default;
+
+    // Allocate work vectors and factor the preconditioner for a grid size
+    void resize(int width, int height);
+
+    // Improve p (ghost cells included) in place, starting from its contents
+    SolverStats solve(Field &p, const Field &rhs, const PcgSettings &settings);
+
+    // Pool used for the vector operations (may be null)
+    void setThreadPool(ThreadPool *pool) { threadPool = pool; }
+
+    // Solid cells to leave out (null for none); the mask must outlive its
+    // use and be set again after it changes, as that refactors the
+    // preconditioner
+    void setObstacles(const ObstacleMask *mask);
+
+private:
+    Field residual;
+    Field auxiliary; // Preconditioned residual
+    Field search;
+    Field product;   // Operator applied to the search direction
+    Field icDiagonal; // Inverse diagonal of the incomplete Cholesky factor
+    ThreadPool *threadPool = nullptr;
+    const ObstacleMask *obstacles = nullptr;
+
+    float operatorDiagonal(int i, int j) const;
+    void applyOperator(Field &x, Field &result);
+    void applyPreconditioner(const Field &r, Field &z, Preconditioner preconditioner);
+    void factorIncompleteCholesky();
+};
+
+#endif // PCG_H
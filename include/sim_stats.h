@@ -0,0 +1,96 @@
+#ifndef SIM_STATS_H
+#define SIM_STATS_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
+
+// Instrumented parts of FluidSim::step
+enum class Stage
+{
+    VelocityStep,
+    DensityStep,
+    Diffuse,
+    Advect,
+    Project,
+    Boundary,
+    Count
+};
+
+const int STAGE_COUNT = static_cast<int>(Stage::Count);
+
+// Short name of a stage, as used in the CSV, JSON and trace output
+const char *getStageName(Stage stage);
+
+// Totals for one stage. Times are inclusive, so boundary updates are also
+// counted in the stage that applied them.
+struct StageStats
+{
+    double seconds = 0.0;
+    long long calls = 0;
+    long long cells = 0; // Cells updated, counting every sweep of iterative stages
+};
+
+// Counters accumulated by FluidSim. A build with FLUID_SIM_INSTRUMENTATION
+// off leaves the stage totals at zero.
+struct SimStats
+{
+    std::array<StageStats, STAGE_COUNT> stages;
+    long long steps = 0;
+    long long substeps = 0; // Equal to steps unless adaptive timestepping splits them
+    long long pressureSolves = 0;
+    long long pressureIterations = 0;
+    float worstPressureResidual = 0.0f;
+    long long diffusionSolves = 0;
+    long long diffusionIterations = 0;
+    float worstDiffusionResidual = 0.0f; // Zero unless a diffusion tolerance is set
+
+    StageStats &operator[](Stage stage) { return stages[static_cast<int>(stage)]; }
+    const StageStats &operator[](Stage stage) const { return stages[static_cast<int>(stage)]; }
+};
+
+// One completed stage span
+struct TraceEvent
+{
+    Stage stage;
+    double startMicroseconds; // Since the recorder was first started
+    double durationMicroseconds;
+};
+
+// Bounded in-memory log of stage spans for chrome://tracing or Perfetto.
+// Idle unless started; once full, further spans are counted and dropped.
+class TraceRecorder
+{
+public:
+    void start(std::size_t capacity = 1 << 20);
+    void stop() { recording = false; }
+    void clear();
+    bool isRecording() const { return recording; }
+
+    void record(Stage stage, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end);
+
+    const std::vector<TraceEvent> &getEvents() const { return events; }
+    std::size_t getDroppedCount() const { return dropped; }
+
+private:
+    bool recording = false;
+    bool started = false;
+    std::chrono::steady_clock::time_point origin;
+    std::size_t capacity = 0;
+    std::size_t dropped = 0;
+    std::vector<TraceEvent> events;
+};
+
+// One row per stage: stage,calls,cells,total_ms,ms_per_step,ns_per_cell
+void writeStatsCsv(std::ostream &out, const SimStats &stats);
+
+// Single JSON object with the step, pressure and diffusion totals and every
+// stage
+void writeStatsJson(std::ostream &out, const SimStats &stats);
+
+// Chrome trace-event JSON, one complete ("X") event per span
+void writeChromeTrace(std::ostream &out, const std::vector<TraceEvent> &events);
+
+#endif // SIM_STATS_H
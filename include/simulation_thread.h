@@ -0,0 +1,78 @@
+#ifndef SIMULATION_THREAD_H
+#define SIMULATION_THREAD_H
+
+#include "fluid_sim.h"
+#include "spsc_queue.h"
+#include "triple_buffer.h"
+#include <atomic>
+#include <thread>
+
+// Snapshot of the fields a renderer needs, taken between two steps
+struct SimFrame
+{
+    Field density;
+    Field velocityX;
+    Field velocityY;
+    long long step = 0; // Steps completed when the snapshot was taken
+};
+
+// Interaction applied to the simulation at the next step boundary
+struct SimInput
+{
+    enum class Kind
+    {
+        Splat,          // Queue splat with FluidSim::addSplat
+        Obstacle,       // Make the cells within splat.radius of the splat's centre solid
+        ClearObstacles,
+        Reset
+    };
+
+    Kind kind = Kind::Splat;
+    Splat splat = {};
+};
+
+// Runs FluidSim::step on a thread of its own. Each finished step is copied
+// into a triple-buffered frame, so the renderer always finds the latest
+// complete state without waiting; input arrives through a lock-free queue
+// and is applied between steps. While running, the simulation must only be
+// touched through this class.
+class SimulationThread
+{
+public:
+    // stepsPerSecond paces the loop to real time; 0 steps as fast as possible
+    SimulationThread(FluidSim &sim, float dt, double stepsPerSecond = 0.0);
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread &) = delete;
+    SimulationThread &operator=(const SimulationThread &) = delete;
+
+    void start();
+    void stop();
+
+    // Queue input from a single producer thread; false if the queue is full
+    // and the input was dropped
+    bool pushInput(const SimInput &input) { return inputs.push(input); }
+
+    // Latest completed frame, valid until the next call, from a single
+    // consumer thread
+    const SimFrame &acquireFrame();
+
+private:
+    static const int INPUT_CAPACITY = 4096;
+
+    FluidSim &sim;
+    float dt;
+    double stepsPerSecond;
+    long long steps = 0;
+
+    TripleBuffer<SimFrame> frames;
+    SpscQueue<SimInput> inputs{INPUT_CAPACITY};
+    std::atomic<bool> running{false};
+    std::thread thread;
+
+    void run();
+    void applyInput(const SimInput &input);
+    void publishFrame();
+};
+
+#endif // SIMULATION_THREAD_H
@@ -0,0 +1,13 @@
+#ifndef SOLVER_STATS_H
+#define SOLVER_STATS_H
+
+// Outcome of an iterative linear solve
+struct SolverStats
+{
+    int iterations = 0;
+    // Final residual relative to the right-hand side (max norm), or 0 when
+    // the solver does not measure it
+    float residual = 0.0f;
+};
+
+#endif // SOLVER_STATS_H
@@ -0,0 +1,41 @@
+#ifndef SPLAT_H
+#define SPLAT_H
+
+#include <vector>
+#include "field.h"
+
+// Profile of a splat around its centre
+enum class SplatShape
+{
+    Disc,    // Full amount on every cell closer than radius to the centre
+    Gaussian // amount * exp(-d^2 / radius^2), cut off at 3 radii
+};
+
+// Density and velocity added around a point. Queued with FluidSim::addSplat
+// the amounts are added once; as an emitter they are rates per second.
+struct Splat
+{
+    SplatShape shape = SplatShape::Gaussian;
+    float x = 0.0f, y = 0.0f; // Centre, in cells
+    float radius = 1.0f;      // In cells
+    float density = 0.0f;
+    float velocityX = 0.0f, velocityY = 0.0f;
+};
+
+// Cells a splat reaches, clipped to the interior of a width x height grid;
+// empty when iBegin >= iEnd or jBegin >= jEnd, which it always is for a splat
+// with a non-finite value
+struct SplatBounds
+{
+    int iBegin, iEnd;
+    int jBegin, jEnd;
+};
+
+SplatBounds getSplatBounds(const Splat &splat, int width, int height);
+
+// Add scale times the splat's profile to the three fields over bounds.
+// weights is scratch space, kept by the caller so repeated splats reuse it.
+void rasterizeSplat(const Splat &splat, float scale, const SplatBounds &bounds, std::vector<float> &weights,
+                    Field &density, Field &velocityX, Field &velocityY);
+
+#endif // SPLAT_H
@@ -0,0 +1,47 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer and one consumer thread
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(std::size_t capacity) : items(capacity + 1) {}
+
+    // Producer side; returns false, dropping the item, when the queue is full
+    bool push(const T &item)
+    {
+        std::size_t tail = writeIndex.load(std::memory_order_relaxed);
+        std::size_t next = advance(tail);
+        if (next == readIndex.load(std::memory_order_acquire))
+            return false;
+        items[tail] = item;
+        writeIndex.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; returns false when the queue is empty
+    bool pop(T &item)
+    {
+        std::size_t head = readIndex.load(std::memory_order_relaxed);
+        if (head == writeIndex.load(std::memory_order_acquire))
+            return false;
+        item = items[head];
+        readIndex.store(advance(head), std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::size_t advance(std::size_t index) const { return index + 1 == items.size() ? 0 : index + 1; }
+
+    std::vector<T> items; // One slot stays empty to tell full from empty
+    // On separate cache lines so the two threads do not contend
+    alignas(64) std::atomic<std::size_t> readIndex{0};
+    alignas(64) std::atomic<std::size_t> writeIndex{0};
+};
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,75 @@
+#ifndef STORAGE_PRECISION_H
+#define STORAGE_PRECISION_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include "field.h"
+
+// Number formats a field can be exported in
+enum class StoragePrecision
+{
+    Float32,  // The field's own values
+    Float16,  // IEEE binary16: 11-bit significand, range up to 65504
+    BFloat16  // Upper half of a float: float range, 8-bit significand
+};
+
+// Read-only view of a field in any layout. Cells are laid out like
+// FieldView, or at rowOffsets[x] + columnOffsets[y] when those are set (the
+// Tiled and Morton layouts). Plain data, for the same reason as FieldView.
+struct StorageView
+{
+    const float *data;
+    int width, height;
+    int stride;
+    int firstRow;
+    const int *rowOffsets;
+    const int *columnOffsets;
+};
+
+inline StorageView storageView(const FieldView &view)
+{
+    return {view.data, view.width, view.height, view.stride, view.firstRow, nullptr, nullptr};
+}
+
+// Copy of a field in any layout, for the advectors to sample
+class SampleField
+{
+public:
+    // (Re)allocate storage for the given size; contents are zeroed
+    void resize(int width, int height, FieldLayout layout);
+
+    // Cell (x, y) is element rowOffset(x) + getColumnOffsets()[y] of data(),
+    // or rowOffset(x) + y in the row layouts, which have no column offsets
+    float *data() { return storage.get(); }
+    std::size_t rowOffset(int x) const
+    {
+        return rowOffsets.empty() ? static_cast<std::size_t>(x) * stride : rowOffsets[x];
+    }
+    const int *getColumnOffsets() const { return columnOffsets.empty() ? nullptr : columnOffsets.data(); }
+    // Rows sharing blocks of the layout, which writers on different threads
+    // should not split
+    int getBlockRows() const { return blockRows; }
+
+    StorageView view() const;
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    FieldLayout getLayout() const { return layout; }
+
+private:
+    struct AlignedDeleter
+    {
+        void operator()(void *p) const { std::free(p); }
+    };
+
+    int width = 0, height = 0;
+    int stride = 0; // Row layouts only
+    int blockRows = 1;
+    FieldLayout layout = FieldLayout::Rows;
+    std::vector<int> rowOffsets, columnOffsets; // Blocked layouts only
+    std::unique_ptr<float[], AlignedDeleter> storage;
+};
+
+#endif // STORAGE_PRECISION_H
@@ -0,0 +1,102 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent pool of worker threads for data-parallel loops over grid rows.
+//
+// parallelFor splits a row range into contiguous bands, one per thread, and
+// blocks until every band is done; the calling thread works on bands too. The
+// split depends only on the range and the thread count, so per-band results
+// (see parallelSum) are reproducible from run to run.
+class ThreadPool
+{
+public:
+    // threadCount includes the calling thread; 0 selects one per hardware core
+    explicit ThreadPool(int threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    int getThreadCount() const { return static_cast<int>(workers.size()) + 1; }
+
+    // Run fn(bandBegin, bandEnd) over [begin, end) and wait for completion
+    void parallelFor(int begin, int end, const std::function<void(int, int)> &fn);
+
+    // Same, also passing the band index to fn(band, bandBegin, bandEnd). Bands
+    // never outnumber getThreadCount(), so it can pick per-thread scratch.
+    void parallelForBands(int begin, int end, const std::function<void(int, int, int)> &fn);
+
+    // Sum fn(bandBegin, bandEnd) over all bands, adding partials in band order
+    double parallelSum(int begin, int end, const std::function<double(int, int)> &fn);
+
+    // Largest fn(bandBegin, bandEnd) over all bands
+    float parallelMax(int begin, int end, const std::function<float(int, int)> &fn);
+
+private:
+    // Rows below which splitting a band further costs more than it saves
+    static const int MIN_ROWS_PER_BAND = 4;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    // fn(band, bandBegin, bandEnd)
+    using BandTask = std::function<void(int, int, int)>;
+
+    // Current job, published under the mutex
+    const BandTask *task = nullptr;
+    int taskBegin = 0, taskEnd = 0, bandCount = 0;
+    std::uint64_t generation = 0;
+    int activeWorkers = 0;
+    bool stopping = false;
+
+    std::atomic<int> nextBand{0};
+    std::atomic<int> completedBands{0};
+
+    int bandsFor(int begin, int end) const;
+    void run(int begin, int end, const BandTask &fn);
+    void runBands();
+    void workerLoop();
+};
+
+// Run fn over [begin, end) on the pool, or inline when there is none
+inline void parallelFor(ThreadPool *pool, int begin, int end, const std::function<void(int, int)> &fn)
+{
+    if (pool)
+        pool->parallelFor(begin, end, fn);
+    else if (begin < end)
+        fn(begin, end);
+}
+
+inline void parallelForBands(ThreadPool *pool, int begin, int end, const std::function<void(int, int, int)> &fn)
+{
+    if (pool)
+        pool->parallelForBands(begin, end, fn);
+    else if (begin < end)
+        fn(0, begin, end);
+}
+
+inline double parallelSum(ThreadPool *pool, int begin, int end, const std::function<double(int, int)> &fn)
+{
+    if (pool)
+        return pool->parallelSum(begin, end, fn);
+    return begin < end ? fn(begin, end) : 0.0;
+}
+
+inline float parallelMax(ThreadPool *pool, int begin, int end, const std::function<float(int, int)> &fn)
+{
+    if (pool)
+        return pool->parallelMax(begin, end, fn);
+    return begin < end ? fn(begin, end) : 0.0f;
+}
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,61 @@
+#ifndef TILE_MASK_H
+#define TILE_MASK_H
+
+#include <vector>
+
+// Activity flags for square tiles of a grid, used to skip the parts of a
+// field where nothing happens. Tile (tx, ty) covers cells
+// [tx * TILE_SIZE, (tx + 1) * TILE_SIZE) x [ty * TILE_SIZE, (ty + 1) * TILE_SIZE).
+class TileMask
+{
+public:
+    static const int TILE_SIZE = 16;
+
+    // Cover a width x height grid; every tile starts active
+    void resize(int width, int height);
+
+    void setAll(bool active);
+    void set(int tx, int ty, bool active) { flags[tx * tilesY + ty] = active; }
+    bool isActive(int tx, int ty) const { return flags[tx * tilesY + ty] != 0; }
+
+    // Activate every tile within radius tiles (Chebyshev distance) of an
+    // active one
+    void dilate(int radius);
+
+    int getTilesX() const { return tilesX; }
+    int getTilesY() const { return tilesY; }
+    int getActiveCount() const;
+
+    // Call fn(jBegin, jEnd) for each run of cells of row x in [jMin, jMax)
+    // covered by consecutive active tiles
+    template <typename Fn>
+    void forEachSpan(int x, int jMin, int jMax, Fn fn) const
+    {
+        const unsigned char *row = &flags[(x / TILE_SIZE) * tilesY];
+        int ty = jMin / TILE_SIZE;
+        int tyEnd = (jMax + TILE_SIZE - 1) / TILE_SIZE;
+        while (ty < tyEnd)
+        {
+            if (!row[ty])
+            {
+                ty++;
+                continue;
+            }
+            int first = ty;
+            while (ty < tyEnd && row[ty])
+            {
+                ty++;
+            }
+            int jBegin = first * TILE_SIZE > jMin ? first * TILE_SIZE : jMin;
+            int jEnd = ty * TILE_SIZE < jMax ? ty * TILE_SIZE : jMax;
+            fn(jBegin, jEnd);
+        }
+    }
+
+private:
+    int tilesX = 0, tilesY = 0;
+    std::vector<unsigned char> flags;   // [tx][ty], like the fields
+    std::vector<unsigned char> scratch; // Dilation pass along y
+};
+
+#endif // TILE_MASK_H
@@ -0,0 +1,48 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+// Lock-free triple buffer handing values from one writer thread to one
+// reader thread. The writer fills getBack() and publishes it; the reader
+// takes the most recently published value and never waits for the writer,
+// and the writer never waits for the reader. Unread values are overwritten.
+template <typename T>
+class TripleBuffer
+{
+public:
+    // Writer side: the slot to fill next
+    T &getBack() { return slots[back]; }
+
+    // Writer side: make the back slot the latest value and take a new back
+    void publish()
+    {
+        int previous = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+        back = previous & INDEX_MASK;
+    }
+
+    // Reader side: switch to the latest published value, if there is a new
+    // one; returns whether the front slot changed
+    bool update()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        int previous = middle.exchange(front, std::memory_order_acq_rel);
+        front = previous & INDEX_MASK;
+        return true;
+    }
+
+    // Reader side: the value taken by the last update()
+    const T &getFront() const { return slots[front]; }
+
+private:
+    static const int FRESH = 4; // Set in middle while it holds an unread value
+    static const int INDEX_MASK = 3;
+
+    T slots[3];
+    int back = 0;                // Owned by the writer
+    std::atomic<int> middle{1};  // Shared; slot index plus FRESH
+    int front = 2;               // Owned by the reader
+};
+
+#endif // TRIPLE_BUFFER_H
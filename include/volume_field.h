@@ -0,0 +1,74 @@
+#ifndef VOLUME_FIELD_H
+#define VOLUME_FIELD_H
+
+#include <cstddef>
+#include <memory>
+#include "field.h"
+
+// Read-only view of a volume's storage: cell (x, y, z) is
+// data[x * sliceStride + y * lineStride + z]. Plain data, like FieldView,
+// so it can be handed to kernels built with different instruction sets.
+struct VolumeView
+{
+    const float *data;
+    int width, height, depth;
+    int lineStride;  // Floats between cells (x, y, z) and (x, y + 1, z)
+    int sliceStride; // Floats between cells (x, y, z) and (x + 1, y, z)
+};
+
+// Scalar 3D grid field stored contiguously on the heap in [x][y][z] order:
+// the cells sharing x and y form one line in memory, and all lines sharing x
+// one slice. The 3D counterpart of Field, with the same alignment.
+class VolumeField
+{
+public:
+    VolumeField() = default;
+    VolumeField(int width, int height, int depth);
+
+    VolumeField(VolumeField &&) = default;
+    VolumeField &operator=(VolumeField &&) = default;
+
+    // (Re)allocate storage for the given size; contents are zeroed
+    void resize(int width, int height, int depth);
+
+    void fill(float value);
+    void copyFrom(const VolumeField &other);
+
+    float &operator()(int x, int y, int z) { return storage[index(x, y) + z]; }
+    float operator()(int x, int y, int z) const { return storage[index(x, y) + z]; }
+
+    float *data() { return storage.get(); }
+    const float *data() const { return storage.get(); }
+    float *line(int x, int y) { return storage.get() + index(x, y); }
+    const float *line(int x, int y) const { return storage.get() + index(x, y); }
+
+    VolumeView view() const { return {storage.get(), width, height, depth, depth, height * depth}; }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getDepth() const { return depth; }
+    std::size_t getSize() const { return static_cast<std::size_t>(width) * height * depth; }
+
+private:
+    struct AlignedDeleter
+    {
+        void operator()(float *p) const { std::free(p); }
+    };
+
+    std::size_t index(int x, int y) const { return (static_cast<std::size_t>(x) * height + y) * depth; }
+
+    int width = 0, height = 0, depth = 0;
+    std::unique_ptr<float[], AlignedDeleter> storage;
+};
+
+// Fill the ghost cells on the six outer walls of a volume. b selects the
+// component: 0 for scalars and 1, 2, 3 for x, y and z velocity, which are
+// mirrored with opposite sign on the walls they cross. Edge and corner
+// cells average their neighbours on the walls, as the 2D corners do.
+void applyBoundary(int b, VolumeField &x);
+
+// Same with the component fixed at compile time; instantiated for B = 0 to 3
+template <int B>
+void applyBoundary(VolumeField &x);
+
+#endif // VOLUME_FIELD_H
@@ -0,0 +1,69 @@
+#ifndef WORK_STEALING_SCHEDULER_H
+#define WORK_STEALING_SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent workers for batches of independent, coarse tasks of uneven cost.
+//
+// run() hands each worker a contiguous share of the task indices. Workers
+// take tasks from the front of their own share; one that runs dry steals the
+// back half of the largest remaining share, so long tasks do not leave the
+// other workers idle at the end of a batch. Each share is a single atomic
+// [begin, end) pair, so taking and stealing are lock-free.
+class WorkStealingScheduler
+{
+public:
+    // workerCount includes the calling thread; 0 selects one per hardware core
+    explicit WorkStealingScheduler(int workerCount = 0);
+    ~WorkStealingScheduler();
+
+    WorkStealingScheduler(const WorkStealingScheduler &) = delete;
+    WorkStealingScheduler &operator=(const WorkStealingScheduler &) = delete;
+
+    int getWorkerCount() const { return static_cast<int>(workers.size()) + 1; }
+
+    // Run fn(worker, task) for every task in [0, taskCount) and wait for all
+    // of them. worker is below getWorkerCount(), so fn can use per-worker
+    // state. fn must not throw.
+    void run(int taskCount, const std::function<void(int, int)> &fn);
+
+    // Tasks taken from another worker's share since construction
+    long long getStealCount() const { return steals; }
+
+private:
+    typedef std::function<void(int, int)> Task;
+
+    // [begin, end) of a worker's remaining task indices, packed as
+    // begin << 32 | end
+    struct alignas(64) Share
+    {
+        std::atomic<std::uint64_t> range{0};
+    };
+
+    std::vector<std::thread> workers;
+    std::unique_ptr<Share[]> shares;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    // Current batch, published under the mutex
+    const Task *task = nullptr;
+    std::uint64_t generation = 0;
+    int activeWorkers = 0;
+    bool stopping = false;
+    std::atomic<long long> steals{0};
+
+    bool take(int worker, int &index);
+    bool steal(int worker);
+    void work(int worker);
+    void workerLoop(int worker);
+};
+
+#endif // WORK_STEALING_SCHEDULER_H
@@ -8,4 +8,4 @@ if [ ! -f "./bin/fluid_sim" ]; then
 fi
 
 # Run the executable file
-./bin/fluid_sim
+./bin/fluid_sim "$@"
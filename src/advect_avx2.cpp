@@ -0,0 +1,63 @@
+// AVX2 advection kernels: 8 lanes with hardware gathers.
+// Built with -mavx2 -mf16c; only called after a CPUID check for both.
+#include "advect_kernels_impl.h"
+#include <immintrin.h>
+
+namespace
+{
+struct Avx2Traits
+{
+    typedef __m256 Float;
+    typedef __m256i Int;
+    static const int LANES = 8;
+
+    static Float load(const float *p) { return _mm256_loadu_ps(p); }
+    static void store(float *p, Float x) { _mm256_storeu_ps(p, x); }
+    static void storeEven(float *p, Float x) { _mm256_maskstore_ps(p, _mm256_setr_epi32(-1, 0, -1, 0, -1, 0, -1, 0), x); }
+    static Float shiftIn(Float previous, Float x)
+    {
+        __m256i middle = _mm256_castps_si256(_mm256_permute2f128_ps(previous, x, 0x21));
+        return _mm256_castsi256_ps(_mm256_alignr_epi8(_mm256_castps_si256(x), middle, 12));
+    }
+    static Float set(float x) { return _mm256_set1_ps(x); }
+    static Float lane() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+    static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+    static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+    static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+    static Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+    // Operand order reproduces std::min/std::max exactly
+    static Float min(Float a, Float b) { return _mm256_min_ps(b, a); }
+    static Float max(Float a, Float b) { return _mm256_max_ps(b, a); }
+    static Float abs(Float x) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x); }
+    static Float sqrt(Float x) { return _mm256_sqrt_ps(x); }
+    static Int truncate(Float x) { return _mm256_cvttps_epi32(x); }
+    static Float toFloat(Int x) { return _mm256_cvtepi32_ps(x); }
+    static Int index(Int i, int stride, Int j) { return _mm256_add_epi32(_mm256_mullo_epi32(i, _mm256_set1_epi32(stride)), j); }
+    static Int offset(Int x, int delta) { return _mm256_add_epi32(x, _mm256_set1_epi32(delta)); }
+    static Int offset(Int x, Int delta) { return _mm256_add_epi32(x, delta); }
+    static Float gather(const float *base, Int index) { return _mm256_i32gather_ps(base, index, 4); }
+    static Int gather(const int *base, Int index) { return _mm256_i32gather_epi32(base, index, 4); }
+
+    static void store(Fp16 *p, Float x)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p), _mm256_cvtps_ph(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    }
+    static void store(Bf16 *p, Float x)
+    {
+        __m256i bits = _mm256_castps_si256(x);
+        __m256i odd = _mm256_and_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(1));
+        __m256i rounded = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(bits, _mm256_set1_epi32(0x7fff)), odd), 16);
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(rounded, rounded), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p), _mm256_castsi256_si128(packed));
+    }
+};
+}
+
+const AdvectKernels &avx2AdvectKernels()
+{
+    static const AdvectKernels kernels = {SimdLevel::AVX2, "avx2", traceRow<Avx2Traits>, rk4Row<Avx2Traits>,
+                                          maxSpeedRow<Avx2Traits>, traceRowStored<Avx2Traits>, rk4RowStored<Avx2Traits>,
+                                          narrowRow<Avx2Traits>, speedRow<Avx2Traits>, traceLine<Avx2Traits>, rk4Line<Avx2Traits>,
+                                          sorLine<Avx2Traits>, gaussSeidelLine<Avx2Traits>};
+    return kernels;
+}
@@ -0,0 +1,65 @@
+// AVX-512 advection kernels: 16 lanes with hardware gathers.
+// Built with -mavx512f; only called after a CPUID check.
+#include "advect_kernels_impl.h"
+#include <immintrin.h>
+
+namespace
+{
+struct Avx512Traits
+{
+    typedef __m512 Float;
+    typedef __m512i Int;
+    static const int LANES = 16;
+
+    static Float load(const float *p) { return _mm512_loadu_ps(p); }
+    static void store(float *p, Float x) { _mm512_storeu_ps(p, x); }
+    static void storeEven(float *p, Float x) { _mm512_mask_storeu_ps(p, 0x5555, x); }
+    static Float shiftIn(Float previous, Float x)
+    {
+        return _mm512_castsi512_ps(_mm512_alignr_epi32(_mm512_castps_si512(x), _mm512_castps_si512(previous), 15));
+    }
+    static Float set(float x) { return _mm512_set1_ps(x); }
+    static Float lane()
+    {
+        return _mm512_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f,
+                              8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f);
+    }
+    static Float add(Float a, Float b) { return _mm512_add_ps(a, b); }
+    static Float sub(Float a, Float b) { return _mm512_sub_ps(a, b); }
+    static Float mul(Float a, Float b) { return _mm512_mul_ps(a, b); }
+    static Float div(Float a, Float b) { return _mm512_div_ps(a, b); }
+    // Operand order reproduces std::min/std::max exactly
+    static Float min(Float a, Float b) { return _mm512_min_ps(b, a); }
+    static Float max(Float a, Float b) { return _mm512_max_ps(b, a); }
+    static Float abs(Float x) { return _mm512_abs_ps(x); }
+    static Float sqrt(Float x) { return _mm512_sqrt_ps(x); }
+    static Int truncate(Float x) { return _mm512_cvttps_epi32(x); }
+    static Float toFloat(Int x) { return _mm512_cvtepi32_ps(x); }
+    static Int index(Int i, int stride, Int j) { return _mm512_add_epi32(_mm512_mullo_epi32(i, _mm512_set1_epi32(stride)), j); }
+    static Int offset(Int x, int delta) { return _mm512_add_epi32(x, _mm512_set1_epi32(delta)); }
+    static Int offset(Int x, Int delta) { return _mm512_add_epi32(x, delta); }
+    static Float gather(const float *base, Int index) { return _mm512_i32gather_ps(index, base, 4); }
+    static Int gather(const int *base, Int index) { return _mm512_i32gather_epi32(index, base, 4); }
+
+    static void store(Fp16 *p, Float x)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), _mm512_cvtps_ph(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    }
+    static void store(Bf16 *p, Float x)
+    {
+        __m512i bits = _mm512_castps_si512(x);
+        __m512i odd = _mm512_and_si512(_mm512_srli_epi32(bits, 16), _mm512_set1_epi32(1));
+        __m512i rounded = _mm512_srli_epi32(_mm512_add_epi32(_mm512_add_epi32(bits, _mm512_set1_epi32(0x7fff)), odd), 16);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), _mm512_cvtepi32_epi16(rounded));
+    }
+};
+}
+
+const AdvectKernels &avx512AdvectKernels()
+{
+    static const AdvectKernels kernels = {SimdLevel::AVX512, "avx512", traceRow<Avx512Traits>, rk4Row<Avx512Traits>,
+                                          maxSpeedRow<Avx512Traits>, traceRowStored<Avx512Traits>, rk4RowStored<Avx512Traits>,
+                                          narrowRow<Avx512Traits>, speedRow<Avx512Traits>, traceLine<Avx512Traits>, rk4Line<Avx512Traits>,
+                                          sorLine<Avx512Traits>, gaussSeidelLine<Avx512Traits>};
+    return kernels;
+}
@@ -0,0 +1,59 @@
+#include "advect_kernels_impl.h"
+
+#ifdef FLUID_SIM_X86_SIMD
+// Defined in the per-instruction-set translation units
+const AdvectKernels &sse41AdvectKernels();
+const AdvectKernels &avx2AdvectKernels();
+const AdvectKernels &avx512AdvectKernels();
+#endif
+
+namespace
+{
+const AdvectKernels SCALAR_KERNELS = {SimdLevel::Scalar, "scalar", traceRow<ScalarTraits>, rk4Row<ScalarTraits>,
+                                      maxSpeedRow<ScalarTraits>, traceRowStored<ScalarTraits>, rk4RowStored<ScalarTraits>,
+                                      narrowRow<ScalarTraits>, speedRow<ScalarTraits>, traceLine<ScalarTraits>, rk4Line<ScalarTraits>,
+                                      sorLine<ScalarTraits>, gaussSeidelLine<ScalarTraits>};
+
+SimdLevel detectSimdLevel()
+{
+#ifdef FLUID_SIM_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return SimdLevel::AVX512;
+    // Every AVX2 CPU has F16C, but the 16-bit export kernels rely on it, so check
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c"))
+        return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return SimdLevel::SSE41;
+#endif
+    return SimdLevel::Scalar;
+}
+}
+
+SimdLevel bestSimdLevel()
+{
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+const AdvectKernels &getAdvectKernels(SimdLevel level)
+{
+    if (static_cast<int>(level) > static_cast<int>(bestSimdLevel()))
+    {
+        level = bestSimdLevel();
+    }
+
+    switch (level)
+    {
+#ifdef FLUID_SIM_X86_SIMD
+    case SimdLevel::AVX512:
+        return avx512AdvectKernels();
+    case SimdLevel::AVX2:
+        return avx2AdvectKernels();
+    case SimdLevel::SSE41:
+        return sse41AdvectKernels();
+#endif
+    default:
+        return SCALAR_KERNELS;
+    }
+}
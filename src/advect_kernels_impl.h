@@ -0,0 +1,745 @@
+// Advection row kernels, written once against a small SIMD traits interface
+// and instantiated by each advect_*.cpp file with its own compiler flags.
+//
+// Everything here has internal linkage: the translation units are compiled
+// for different instruction sets, and sharing an inline symbol between them
+// could let the linker pick an AVX copy for code that runs on any CPU. For the
+// same reason the kernels avoid calling inline functions from other headers.
+
+#ifndef ADVECT_KERNELS_IMPL_H
+#define ADVECT_KERNELS_IMPL_H
+
+#include "advect_kernels.h"
+#include <cstring>
+#include <math.h>
+
+namespace
+{
+// Cells of 16-bit export buffers, as distinct types so the traits can
+// overload on them
+struct Fp16
+{
+    std::uint16_t bits;
+};
+
+struct Bf16
+{
+    std::uint16_t bits;
+};
+
+inline std::uint32_t floatBits(float x)
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    return bits;
+}
+
+inline float bitsFloat(std::uint32_t bits)
+{
+    float x;
+    std::memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+// Float to binary16, rounding to nearest even like F16C for every finite
+// input; NaNs become the default quiet NaN
+inline std::uint16_t floatToHalf(float x)
+{
+    std::uint32_t bits = floatBits(x);
+    std::uint32_t sign = bits & 0x80000000u;
+    bits ^= sign;
+
+    std::uint32_t half;
+    if (bits >= (127u + 16) << 23)
+    {
+        half = bits > 255u << 23 ? 0x7e00 : 0x7c00;
+    }
+    else if (bits < 113u << 23)
+    {
+        // Subnormal or zero: one float addition aligns and rounds the bits
+        const std::uint32_t magic = ((127 - 15) + (23 - 10) + 1) << 23;
+        half = floatBits(bitsFloat(bits) + bitsFloat(magic)) - magic;
+    }
+    else
+    {
+        std::uint32_t odd = (bits >> 13) & 1;
+        bits += ((15u - 127) << 23) + 0xfff + odd;
+        half = bits >> 13;
+    }
+    return static_cast<std::uint16_t>(half | sign >> 16);
+}
+
+// Float to bfloat16, rounding to nearest even
+inline std::uint16_t floatToBfloat(float x)
+{
+    std::uint32_t bits = floatBits(x);
+    return static_cast<std::uint16_t>((bits + 0x7fffu + ((bits >> 16) & 1)) >> 16);
+}
+
+// One lane, used for the scalar build and for the tail of every row
+struct ScalarTraits
+{
+    typedef float Float;
+    typedef int Int;
+    static const int LANES = 1;
+
+    static Float load(const float *p) { return *p; }
+    static void store(float *p, Float x) { *p = x; }
+    static void storeEven(float *p, Float x) { *p = x; } // Lanes 0, 2, ... only
+    static Float shiftIn(Float previous, Float) { return previous; } // Lanes up one, previous's last in lane 0
+    static Float set(float x) { return x; }
+    static Float lane() { return 0.0f; } // Offsets of the lanes from the first
+    static Float add(Float a, Float b) { return a + b; }
+    static Float sub(Float a, Float b) { return a - b; }
+    static Float mul(Float a, Float b) { return a * b; }
+    static Float div(Float a, Float b) { return a / b; }
+    static Float min(Float a, Float b) { return b < a ? b : a; }
+    static Float max(Float a, Float b) { return a < b ? b : a; }
+    static Float abs(Float x) { return x < 0.0f ? -x : x; }
+    static Float sqrt(Float x) { return sqrtf(x); } // The C function, not the inline std::sqrt
+    static Int truncate(Float x) { return static_cast<int>(x); }
+    static Float toFloat(Int x) { return static_cast<float>(x); }
+    static Int index(Int i, int stride, Int j) { return i * stride + j; }
+    static Int offset(Int x, int delta) { return x + delta; }
+    static Float gather(const float *base, Int index) { return base[index]; }
+    static Int gather(const int *base, Int index) { return base[index]; }
+
+    static void store(Fp16 *p, Float x) { p->bits = floatToHalf(x); }
+    static void store(Bf16 *p, Float x) { p->bits = floatToBfloat(x); }
+};
+
+// A row-layout StorageView as a FieldView, and row x of it
+inline FieldView fieldView(const StorageView &view)
+{
+    return {view.data, view.width, view.height, view.stride, view.firstRow};
+}
+
+inline const float *viewRow(const StorageView &view, int x)
+{
+    return view.data + static_cast<std::size_t>(x - view.firstRow) * view.stride;
+}
+
+// Whole field in a blocked layout: cell (x, y) is at
+// data[rowOffsets[x] + columnOffsets[y]]
+struct OffsetView
+{
+    const float *data;
+    int width, height;
+    const int *rowOffsets;
+    const int *columnOffsets;
+};
+
+inline OffsetView offsetView(const StorageView &view)
+{
+    return {view.data, view.width, view.height, view.rowOffsets, view.columnOffsets};
+}
+
+// Cell coordinates, bilinear weights and flat index of a clamped sample point
+template <typename S>
+struct SamplePoint
+{
+    typename S::Int index; // Flat index of the (i0, j0) corner
+    typename S::Float s0, s1, t0, t1;
+};
+
+// The same for OffsetView, which finds the corners through its tables
+template <typename S>
+struct OffsetPoint
+{
+    typename S::Int i0, j0;
+    typename S::Float s0, s1, t0, t1;
+};
+
+template <typename S>
+struct SampleBounds
+{
+    typename S::Float low, highX, highY;
+
+    template <typename View>
+    explicit SampleBounds(const View &field)
+        : low(S::set(0.5f)), highX(S::set(field.width - 1.5f)), highY(S::set(field.height - 1.5f))
+    {
+    }
+};
+
+// Clamp (x, y) into the grid, returning its corner cell and setting the
+// bilinear weights of point
+template <typename S, typename Point>
+inline void locateCell(typename S::Float x, typename S::Float y, const SampleBounds<S> &bounds,
+                       typename S::Int &i0, typename S::Int &j0, Point &point)
+{
+    x = S::max(bounds.low, S::min(bounds.highX, x));
+    y = S::max(bounds.low, S::min(bounds.highY, y));
+
+    i0 = S::truncate(x);
+    j0 = S::truncate(y);
+
+    point.s1 = S::sub(x, S::toFloat(i0));
+    point.s0 = S::sub(S::set(1.0f), point.s1);
+    point.t1 = S::sub(y, S::toFloat(j0));
+    point.t0 = S::sub(S::set(1.0f), point.t1);
+}
+
+// Clamp (x, y) into the grid and compute its interpolation stencil in field
+template <typename S>
+inline SamplePoint<S> locate(typename S::Float x, typename S::Float y, const SampleBounds<S> &bounds,
+                             const FieldView &field)
+{
+    typename S::Int i0, j0;
+    SamplePoint<S> point;
+    locateCell<S>(x, y, bounds, i0, j0, point);
+    point.index = S::index(S::offset(i0, -field.firstRow), field.stride, j0);
+    return point;
+}
+
+template <typename S>
+inline OffsetPoint<S> locate(typename S::Float x, typename S::Float y, const SampleBounds<S> &bounds,
+                             const OffsetView &)
+{
+    OffsetPoint<S> point;
+    locateCell<S>(x, y, bounds, point.i0, point.j0, point);
+    return point;
+}
+
+// s0 * (t0 * f[i0][j0] + t1 * f[i0][j1]) + s1 * (t0 * f[i1][j0] + t1 * f[i1][j1])
+template <typename S, typename Point>
+inline typename S::Float blend(const Point &p, typename S::Float f00, typename S::Float f01,
+                               typename S::Float f10, typename S::Float f11)
+{
+    return S::add(S::mul(p.s0, S::add(S::mul(p.t0, f00), S::mul(p.t1, f01))),
+                  S::mul(p.s1, S::add(S::mul(p.t0, f10), S::mul(p.t1, f11))));
+}
+
+template <typename S>
+inline typename S::Float interpolate(const float *data, int stride, const SamplePoint<S> &p)
+{
+    typedef typename S::Float Float;
+
+    Float f00 = S::gather(data, p.index);
+    Float f01 = S::gather(data, S::offset(p.index, 1));
+    Float f10 = S::gather(data, S::offset(p.index, stride));
+    Float f11 = S::gather(data, S::offset(p.index, stride + 1));
+    return blend<S>(p, f00, f01, f10, f11);
+}
+
+// Bilinear sample of field at a point located in it
+template <typename S>
+inline typename S::Float sample(const FieldView &field, const SamplePoint<S> &p)
+{
+    return interpolate<S>(field.data, field.stride, p);
+}
+
+template <typename S>
+inline typename S::Float sample(const OffsetView &field, const OffsetPoint<S> &p)
+{
+    typedef typename S::Float Float;
+    typedef typename S::Int Int;
+
+    Int row0 = S::gather(field.rowOffsets, p.i0);
+    Int row1 = S::gather(field.rowOffsets, S::offset(p.i0, 1));
+    Int column0 = S::gather(field.columnOffsets, p.j0);
+    Int column1 = S::gather(field.columnOffsets, S::offset(p.j0, 1));
+
+    Float f00 = S::gather(field.data, S::offset(row0, column0));
+    Float f01 = S::gather(field.data, S::offset(row0, column1));
+    Float f10 = S::gather(field.data, S::offset(row1, column0));
+    Float f11 = S::gather(field.data, S::offset(row1, column1));
+    return blend<S>(p, f00, f01, f10, f11);
+}
+
+template <typename S, typename View>
+inline int traceCells(float *dest, const View &source, const float *u, const float *v,
+                      int i, int jBegin, int jEnd, float scale)
+{
+    typedef typename S::Float Float;
+
+    SampleBounds<S> bounds(source);
+    Float scaleV = S::set(scale);
+    Float x0 = S::set(static_cast<float>(i));
+
+    int j = jBegin;
+    for (; j + S::LANES <= jEnd; j += S::LANES)
+    {
+        Float x = S::add(x0, S::mul(scaleV, S::load(u + j)));
+        Float y = S::add(S::add(S::set(static_cast<float>(j)), S::lane()), S::mul(scaleV, S::load(v + j)));
+        S::store(dest + j, sample<S>(source, locate<S>(x, y, bounds, source)));
+    }
+    return j;
+}
+
+template <typename S>
+void traceRow(float *dest, FieldView source, const float *u, const float *v,
+              int i, int jBegin, int jEnd, float scale)
+{
+    int j = traceCells<S>(dest, source, u, v, i, jBegin, jEnd, scale);
+    traceCells<ScalarTraits>(dest, source, u, v, i, j, jEnd, scale);
+}
+
+// Velocity (u, v) interpolated at (x, y) and scaled by factor
+template <typename S, typename View>
+inline void velocityAt(const View &u, const View &v, const SampleBounds<S> &bounds,
+                       typename S::Float x, typename S::Float y, typename S::Float factor,
+                       typename S::Float &kx, typename S::Float &ky)
+{
+    auto p = locate<S>(x, y, bounds, u);
+    kx = S::mul(sample<S>(u, p), factor);
+    ky = S::mul(sample<S>(v, p), factor);
+}
+
+template <typename S, typename Source, typename Velocity>
+inline int rk4Cells(float *dest, const Source &source, const Velocity &u, const Velocity &v,
+                    int i, int jBegin, int jEnd, float dt0)
+{
+    typedef typename S::Float Float;
+
+    SampleBounds<S> bounds(source);
+    Float factor = S::set(-dt0);
+    Float half = S::set(0.5f);
+    Float two = S::set(2.0f);
+    Float six = S::set(6.0f);
+    Float x = S::set(static_cast<float>(i));
+
+    int j = jBegin;
+    for (; j + S::LANES <= jEnd; j += S::LANES)
+    {
+        Float y = S::add(S::set(static_cast<float>(j)), S::lane());
+        Float k1x, k1y, k2x, k2y, k3x, k3y, k4x, k4y;
+
+        // k1: initial velocity at current position
+        velocityAt<S>(u, v, bounds, x, y, factor, k1x, k1y);
+        // k2, k3: velocity at the midpoints
+        velocityAt<S>(u, v, bounds, S::add(x, S::mul(k1x, half)), S::add(y, S::mul(k1y, half)), factor, k2x, k2y);
+        velocityAt<S>(u, v, bounds, S::add(x, S::mul(k2x, half)), S::add(y, S::mul(k2y, half)), factor, k3x, k3y);
+        // k4: velocity at the endpoint
+        velocityAt<S>(u, v, bounds, S::add(x, k3x), S::add(y, k3y), factor, k4x, k4y);
+
+        // (k1 + 2 k2 + 2 k3 + k4) / 6
+        Float dx = S::div(S::add(S::add(S::add(k1x, S::mul(two, k2x)), S::mul(two, k3x)), k4x), six);
+        Float dy = S::div(S::add(S::add(S::add(k1y, S::mul(two, k2y)), S::mul(two, k3y)), k4y), six);
+
+        S::store(dest + j, sample<S>(source, locate<S>(S::add(x, dx), S::add(y, dy), bounds, source)));
+    }
+    return j;
+}
+
+template <typename S>
+inline int maxSpeedCells(const float *u, const float *v, int jBegin, int jEnd, typename S::Float &result)
+{
+    int j = jBegin;
+    for (; j + S::LANES <= jEnd; j += S::LANES)
+    {
+        result = S::max(result, S::max(S::abs(S::load(u + j)), S::abs(S::load(v + j))));
+    }
+    return j;
+}
+
+template <typename S>
+float maxSpeedRow(const float *u, const float *v, int jBegin, int jEnd)
+{
+    typename S::Float lanes = S::set(0.0f);
+    int j = maxSpeedCells<S>(u, v, jBegin, jEnd, lanes);
+
+    float values[S::LANES];
+    S::store(values, lanes);
+    float result = 0.0f;
+    for (int k = 0; k < S::LANES; k++)
+    {
+        result = ScalarTraits::max(result, values[k]);
+    }
+    maxSpeedCells<ScalarTraits>(u, v, j, jEnd, result);
+    return result;
+}
+
+template <typename S>
+void rk4Row(float *dest, FieldView source, FieldView u, FieldView v,
+            int i, int jBegin, int jEnd, float dt0)
+{
+    int j = rk4Cells<S>(dest, source, u, v, i, jBegin, jEnd, dt0);
+    rk4Cells<ScalarTraits>(dest, source, u, v, i, j, jEnd, dt0);
+}
+
+// traceRow and rk4Row with the source and the velocity each read in its
+// stored layout, dispatched once per row
+template <typename S, typename View>
+void traceRowFrom(float *dest, const View &source, const float *uRow, const float *vRow,
+                  int i, int jBegin, int jEnd, float scale)
+{
+    int j = traceCells<S>(dest, source, uRow, vRow, i, jBegin, jEnd, scale);
+    traceCells<ScalarTraits>(dest, source, uRow, vRow, i, j, jEnd, scale);
+}
+
+template <typename S>
+void traceRowStored(float *dest, StorageView source, StorageView u, StorageView v,
+                    int i, int jBegin, int jEnd, float scale)
+{
+    const float *uRow = viewRow(u, i);
+    const float *vRow = viewRow(v, i);
+    if (source.rowOffsets)
+        traceRowFrom<S>(dest, offsetView(source), uRow, vRow, i, jBegin, jEnd, scale);
+    else
+        traceRowFrom<S>(dest, fieldView(source), uRow, vRow, i, jBegin, jEnd, scale);
+}
+
+template <typename S, typename Source, typename Velocity>
+void rk4RowFrom(float *dest, const Source &source, const Velocity &u, const Velocity &v,
+                int i, int jBegin, int jEnd, float dt0)
+{
+    int j = rk4Cells<S>(dest, source, u, v, i, jBegin, jEnd, dt0);
+    rk4Cells<ScalarTraits>(dest, source, u, v, i, j, jEnd, dt0);
+}
+
+template <typename S>
+void rk4RowStored(float *dest, StorageView source, StorageView u, StorageView v,
+                  int i, int jBegin, int jEnd, float dt0)
+{
+    if (source.rowOffsets)
+        rk4RowFrom<S>(dest, offsetView(source), offsetView(u), offsetView(v), i, jBegin, jEnd, dt0);
+    else
+        rk4RowFrom<S>(dest, fieldView(source), fieldView(u), fieldView(v), i, jBegin, jEnd, dt0);
+}
+
+template <typename S, typename T>
+inline int narrowCells(T *dest, const float *source, int begin, int end)
+{
+    int k = begin;
+    for (; k + S::LANES <= end; k += S::LANES)
+    {
+        S::store(dest + k, S::load(source + k));
+    }
+    return k;
+}
+
+template <typename S, typename T>
+void narrowRowAs(T *dest, const float *source, int count)
+{
+    int k = narrowCells<S>(dest, source, 0, count);
+    narrowCells<ScalarTraits>(dest, source, k, count);
+}
+
+template <typename S>
+void narrowRow(std::uint16_t *dest, const float *source, int count, StoragePrecision precision)
+{
+    if (precision == StoragePrecision::BFloat16)
+        narrowRowAs<S>(reinterpret_cast<Bf16 *>(dest), source, count);
+    else
+        narrowRowAs<S>(reinterpret_cast<Fp16 *>(dest), source, count);
+}
+
+template <typename S>
+inline int speedCells(float *dest, const float *u, const float *v, int begin, int end)
+{
+    int k = begin;
+    for (; k + S::LANES <= end; k += S::LANES)
+    {
+        typename S::Float x = S::load(u + k);
+        typename S::Float y = S::load(v + k);
+        S::store(dest + k, S::sqrt(S::add(S::mul(x, x), S::mul(y, y))));
+    }
+    return k;
+}
+
+template <typename S>
+void speedRow(float *dest, const float *u, const float *v, int count)
+{
+    int k = speedCells<S>(dest, u, v, 0, count);
+    speedCells<ScalarTraits>(dest, u, v, k, count);
+}
+
+// Red-black relaxation along a line, updating cells k, k + 2, ... A vector
+// covers every other lane: each lane is computed and storeEven writes the
+// even ones, leaving the other color untouched. x[k - 1] is shifted in from
+// the previous vector rather than reloaded, since a load overlapping the
+// masked store just issued would stall until that store retires.
+// sum + lines[first..COUNT)[k] + right + left, in that order, with COUNT 2 or 4
+template <typename S, int COUNT>
+inline typename S::Float sumNeighbours(typename S::Float sum, const float *const *lines, int first, int k,
+                                       typename S::Float right, typename S::Float left)
+{
+    if (first == 0)
+        sum = S::add(sum, S::load(lines[0] + k));
+    sum = S::add(sum, S::load(lines[1] + k));
+    if (COUNT == 4)
+    {
+        sum = S::add(sum, S::load(lines[2] + k));
+        sum = S::add(sum, S::load(lines[3] + k));
+    }
+    return S::add(S::add(sum, right), left);
+}
+
+template <typename S, int COUNT>
+inline int sorCells(float *x, const float *b, const float *const *lines, int k, int end,
+                    float a, float cRecip, float omega)
+{
+    typedef typename S::Float Float;
+
+    if (k + S::LANES > end)
+        return k;
+
+    Float aV = S::set(a);
+    Float cRecipV = S::set(cRecip);
+    Float omegaV = S::set(omega);
+    Float old = S::load(x + k);
+    Float left = S::load(x + k - 1);
+    for (;;)
+    {
+        Float sum = sumNeighbours<S, COUNT>(S::load(lines[0] + k), lines, 1, k, S::load(x + k + 1), left);
+        Float newValue = S::mul(S::add(S::load(b + k), S::mul(aV, sum)), cRecipV);
+        S::storeEven(x + k, S::add(old, S::mul(omegaV, S::sub(newValue, old))));
+
+        k += S::LANES;
+        if (k + S::LANES > end)
+            return k;
+        Float next = S::load(x + k);
+        left = S::shiftIn(old, next);
+        old = next;
+    }
+}
+
+// Scalar loop for the scalar build and the tail of every line
+template <int COUNT>
+inline void sorTail(float *x, const float *b, const float *const *lines, int k, int end,
+                    float a, float cRecip, float omega)
+{
+    for (; k < end; k += 2)
+    {
+        float sum = sumNeighbours<ScalarTraits, COUNT>(lines[0][k], lines, 1, k, x[k + 1], x[k - 1]);
+        float newValue = (b[k] + a * sum) * cRecip;
+        x[k] = x[k] + omega * (newValue - x[k]);
+    }
+}
+
+template <typename S, int COUNT>
+inline void sorLineOf(float *x, const float *b, const float *const *neighbours, int kBegin, int kEnd,
+                      float a, float cRecip, float omega)
+{
+    const float *lines[COUNT];
+    for (int n = 0; n < COUNT; n++)
+    {
+        lines[n] = neighbours[n];
+    }
+    int k = S::LANES > 1 ? sorCells<S, COUNT>(x, b, lines, kBegin, kEnd, a, cRecip, omega) : kBegin;
+    sorTail<COUNT>(x, b, lines, k, kEnd, a, cRecip, omega);
+}
+
+template <typename S>
+void sorLine(float *x, const float *b, const float *const *neighbours, int neighbourCount,
+             int kBegin, int kEnd, float a, float cRecip, float omega)
+{
+    if (neighbourCount == 2)
+        sorLineOf<S, 2>(x, b, neighbours, kBegin, kEnd, a, cRecip, omega);
+    else
+        sorLineOf<S, 4>(x, b, neighbours, kBegin, kEnd, a, cRecip, omega);
+}
+
+template <typename S, int COUNT>
+inline int gaussSeidelCells(float *x, const float *b, const float *const *lines, int k, int end, float divisor)
+{
+    typedef typename S::Float Float;
+
+    if (k + S::LANES > end)
+        return k;
+
+    Float divisorV = S::set(divisor);
+    Float old = S::load(x + k);
+    Float left = S::load(x + k - 1);
+    for (;;)
+    {
+        Float sum = sumNeighbours<S, COUNT>(S::load(b + k), lines, 0, k, S::load(x + k + 1), left);
+        S::storeEven(x + k, S::div(sum, divisorV));
+
+        k += S::LANES;
+        if (k + S::LANES > end)
+            return k;
+        Float next = S::load(x + k);
+        left = S::shiftIn(old, next);
+        old = next;
+    }
+}
+
+template <int COUNT>
+inline void gaussSeidelTail(float *x, const float *b, const float *const *lines, int k, int end, float divisor)
+{
+    for (; k < end; k += 2)
+    {
+        x[k] = sumNeighbours<ScalarTraits, COUNT>(b[k], lines, 0, k, x[k + 1], x[k - 1]) / divisor;
+    }
+}
+
+template <typename S, int COUNT>
+inline void gaussSeidelLineOf(float *x, const float *b, const float *const *neighbours, int kBegin, int kEnd,
+                              float divisor)
+{
+    const float *lines[COUNT];
+    for (int n = 0; n < COUNT; n++)
+    {
+        lines[n] = neighbours[n];
+    }
+    int k = S::LANES > 1 ? gaussSeidelCells<S, COUNT>(x, b, lines, kBegin, kEnd, divisor) : kBegin;
+    gaussSeidelTail<COUNT>(x, b, lines, k, kEnd, divisor);
+}
+
+template <typename S>
+void gaussSeidelLine(float *x, const float *b, const float *const *neighbours, int neighbourCount,
+                     int kBegin, int kEnd, float divisor)
+{
+    if (neighbourCount == 2)
+        gaussSeidelLineOf<S, 2>(x, b, neighbours, kBegin, kEnd, divisor);
+    else
+        gaussSeidelLineOf<S, 4>(x, b, neighbours, kBegin, kEnd, divisor);
+}
+
+// The 3D kernels below mirror the 2D ones, with the z axis along a line
+
+template <typename S>
+struct VolumePoint
+{
+    typename S::Int index; // Flat index of the (i0, j0, k0) corner
+    typename S::Float s0, s1, t0, t1, r0, r1;
+};
+
+template <typename S>
+struct VolumeBounds
+{
+    typename S::Float low, highX, highY, highZ;
+
+    explicit VolumeBounds(const VolumeView &field)
+        : low(S::set(0.5f)), highX(S::set(field.width - 1.5f)), highY(S::set(field.height - 1.5f)),
+          highZ(S::set(field.depth - 1.5f))
+    {
+    }
+};
+
+template <typename S>
+inline VolumePoint<S> locate(typename S::Float x, typename S::Float y, typename S::Float z,
+                             const VolumeBounds<S> &bounds, const VolumeView &field)
+{
+    typedef typename S::Int Int;
+
+    x = S::max(bounds.low, S::min(bounds.highX, x));
+    y = S::max(bounds.low, S::min(bounds.highY, y));
+    z = S::max(bounds.low, S::min(bounds.highZ, z));
+
+    Int i0 = S::truncate(x);
+    Int j0 = S::truncate(y);
+    Int k0 = S::truncate(z);
+
+    VolumePoint<S> point;
+    point.s1 = S::sub(x, S::toFloat(i0));
+    point.s0 = S::sub(S::set(1.0f), point.s1);
+    point.t1 = S::sub(y, S::toFloat(j0));
+    point.t0 = S::sub(S::set(1.0f), point.t1);
+    point.r1 = S::sub(z, S::toFloat(k0));
+    point.r0 = S::sub(S::set(1.0f), point.r1);
+    point.index = S::index(i0, field.sliceStride, S::index(j0, field.lineStride, k0));
+    return point;
+}
+
+// Bilinear in (y, z) on each of the two slices, then linear in x
+template <typename S>
+inline typename S::Float interpolate(const VolumeView &field, const VolumePoint<S> &p)
+{
+    typedef typename S::Float Float;
+    typedef typename S::Int Int;
+
+    Float slices[2];
+    for (int s = 0; s < 2; s++)
+    {
+        Int base = S::offset(p.index, s * field.sliceStride);
+        Float f00 = S::gather(field.data, base);
+        Float f01 = S::gather(field.data, S::offset(base, 1));
+        Float f10 = S::gather(field.data, S::offset(base, field.lineStride));
+        Float f11 = S::gather(field.data, S::offset(base, field.lineStride + 1));
+        slices[s] = S::add(S::mul(p.t0, S::add(S::mul(p.r0, f00), S::mul(p.r1, f01))),
+                           S::mul(p.t1, S::add(S::mul(p.r0, f10), S::mul(p.r1, f11))));
+    }
+    return S::add(S::mul(p.s0, slices[0]), S::mul(p.s1, slices[1]));
+}
+
+template <typename S>
+inline int traceCells(float *dest, const VolumeView &source, const float *u, const float *v, const float *w,
+                      int i, int j, int kBegin, int kEnd, float scale)
+{
+    typedef typename S::Float Float;
+
+    VolumeBounds<S> bounds(source);
+    Float scaleV = S::set(scale);
+    Float x0 = S::set(static_cast<float>(i));
+    Float y0 = S::set(static_cast<float>(j));
+
+    int k = kBegin;
+    for (; k + S::LANES <= kEnd; k += S::LANES)
+    {
+        Float x = S::add(x0, S::mul(scaleV, S::load(u + k)));
+        Float y = S::add(y0, S::mul(scaleV, S::load(v + k)));
+        Float z = S::add(S::add(S::set(static_cast<float>(k)), S::lane()), S::mul(scaleV, S::load(w + k)));
+        S::store(dest + k, interpolate<S>(source, locate<S>(x, y, z, bounds, source)));
+    }
+    return k;
+}
+
+template <typename S>
+void traceLine(float *dest, VolumeView source, const float *u, const float *v, const float *w,
+               int i, int j, int kBegin, int kEnd, float scale)
+{
+    int k = traceCells<S>(dest, source, u, v, w, i, j, kBegin, kEnd, scale);
+    traceCells<ScalarTraits>(dest, source, u, v, w, i, j, k, kEnd, scale);
+}
+
+template <typename S>
+inline void velocityAt(const VolumeView &u, const VolumeView &v, const VolumeView &w, const VolumeBounds<S> &bounds,
+                       typename S::Float x, typename S::Float y, typename S::Float z, typename S::Float factor,
+                       typename S::Float &kx, typename S::Float &ky, typename S::Float &kz)
+{
+    VolumePoint<S> p = locate<S>(x, y, z, bounds, u);
+    kx = S::mul(interpolate<S>(u, p), factor);
+    ky = S::mul(interpolate<S>(v, p), factor);
+    kz = S::mul(interpolate<S>(w, p), factor);
+}
+
+template <typename S>
+inline int rk4Cells(float *dest, const VolumeView &source, const VolumeView &u, const VolumeView &v,
+                    const VolumeView &w, int i, int j, int kBegin, int kEnd, float dt0)
+{
+    typedef typename S::Float Float;
+
+    VolumeBounds<S> bounds(source);
+    Float factor = S::set(-dt0);
+    Float half = S::set(0.5f);
+    Float two = S::set(2.0f);
+    Float six = S::set(6.0f);
+    Float x = S::set(static_cast<float>(i));
+    Float y = S::set(static_cast<float>(j));
+
+    int k = kBegin;
+    for (; k + S::LANES <= kEnd; k += S::LANES)
+    {
+        Float z = S::add(S::set(static_cast<float>(k)), S::lane());
+        Float k1x, k1y, k1z, k2x, k2y, k2z, k3x, k3y, k3z, k4x, k4y, k4z;
+
+        velocityAt<S>(u, v, w, bounds, x, y, z, factor, k1x, k1y, k1z);
+        velocityAt<S>(u, v, w, bounds, S::add(x, S::mul(k1x, half)), S::add(y, S::mul(k1y, half)),
+                      S::add(z, S::mul(k1z, half)), factor, k2x, k2y, k2z);
+        velocityAt<S>(u, v, w, bounds, S::add(x, S::mul(k2x, half)), S::add(y, S::mul(k2y, half)),
+                      S::add(z, S::mul(k2z, half)), factor, k3x, k3y, k3z);
+        velocityAt<S>(u, v, w, bounds, S::add(x, k3x), S::add(y, k3y), S::add(z, k3z), factor, k4x, k4y, k4z);
+
+        Float dx = S::div(S::add(S::add(S::add(k1x, S::mul(two, k2x)), S::mul(two, k3x)), k4x), six);
+        Float dy = S::div(S::add(S::add(S::add(k1y, S::mul(two, k2y)), S::mul(two, k3y)), k4y), six);
+        Float dz = S::div(S::add(S::add(S::add(k1z, S::mul(two, k2z)), S::mul(two, k3z)), k4z), six);
+
+        VolumePoint<S> p = locate<S>(S::add(x, dx), S::add(y, dy), S::add(z, dz), bounds, source);
+        S::store(dest + k, interpolate<S>(source, p));
+    }
+    return k;
+}
+
+template <typename S>
+void rk4Line(float *dest, VolumeView source, VolumeView u, VolumeView v, VolumeView w,
+             int i, int j, int kBegin, int kEnd, float dt0)
+{
+    int k = rk4Cells<S>(dest, source, u, v, w, i, j, kBegin, kEnd, dt0);
+    rk4Cells<ScalarTraits>(dest, source, u, v, w, i, j, k, kEnd, dt0);
+}
+}
+
+#endif // ADVECT_KERNELS_IMPL_H
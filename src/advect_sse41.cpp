@@ -0,0 +1,79 @@
+// SSE4.1 advection kernels: 4 lanes, gathers emulated with scalar loads.
+// Built with -msse4.1; only called after a CPUID check.
+#include "advect_kernels_impl.h"
+#include <smmintrin.h>
+
+namespace
+{
+struct Sse41Traits
+{
+    typedef __m128 Float;
+    typedef __m128i Int;
+    static const int LANES = 4;
+
+    static Float load(const float *p) { return _mm_loadu_ps(p); }
+    static void store(float *p, Float x) { _mm_storeu_ps(p, x); }
+    static void storeEven(float *p, Float x)
+    {
+        _mm_store_ss(p, x);
+        _mm_store_ss(p + 2, _mm_movehl_ps(x, x));
+    }
+    static Float shiftIn(Float previous, Float x)
+    {
+        return _mm_castsi128_ps(_mm_alignr_epi8(_mm_castps_si128(x), _mm_castps_si128(previous), 12));
+    }
+    static Float set(float x) { return _mm_set1_ps(x); }
+    static Float lane() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+    static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+    static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+    static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+    static Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+    // Operand order reproduces std::min/std::max exactly
+    static Float min(Float a, Float b) { return _mm_min_ps(b, a); }
+    static Float max(Float a, Float b) { return _mm_max_ps(b, a); }
+    static Float abs(Float x) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), x); }
+    static Float sqrt(Float x) { return _mm_sqrt_ps(x); }
+    static Int truncate(Float x) { return _mm_cvttps_epi32(x); }
+    static Float toFloat(Int x) { return _mm_cvtepi32_ps(x); }
+    static Int index(Int i, int stride, Int j) { return _mm_add_epi32(_mm_mullo_epi32(i, _mm_set1_epi32(stride)), j); }
+    static Int offset(Int x, int delta) { return _mm_add_epi32(x, _mm_set1_epi32(delta)); }
+    static Int offset(Int x, Int delta) { return _mm_add_epi32(x, delta); }
+    static Float gather(const float *base, Int index)
+    {
+        return _mm_setr_ps(base[_mm_extract_epi32(index, 0)], base[_mm_extract_epi32(index, 1)],
+                           base[_mm_extract_epi32(index, 2)], base[_mm_extract_epi32(index, 3)]);
+    }
+    static Int gather(const int *base, Int index)
+    {
+        return _mm_setr_epi32(base[_mm_extract_epi32(index, 0)], base[_mm_extract_epi32(index, 1)],
+                              base[_mm_extract_epi32(index, 2)], base[_mm_extract_epi32(index, 3)]);
+    }
+
+    // Without F16C, binary16 converts one lane at a time
+    static void store(Fp16 *p, Float x)
+    {
+        float values[LANES];
+        _mm_storeu_ps(values, x);
+        for (int k = 0; k < LANES; k++)
+        {
+            p[k].bits = floatToHalf(values[k]);
+        }
+    }
+    static void store(Bf16 *p, Float x)
+    {
+        __m128i bits = _mm_castps_si128(x);
+        __m128i odd = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(1));
+        __m128i rounded = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, _mm_set1_epi32(0x7fff)), odd), 16);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(p), _mm_packus_epi32(rounded, rounded));
+    }
+};
+}
+
+const AdvectKernels &sse41AdvectKernels()
+{
+    static const AdvectKernels kernels = {SimdLevel::SSE41, "sse4.1", traceRow<Sse41Traits>, rk4Row<Sse41Traits>,
+                                          maxSpeedRow<Sse41Traits>, traceRowStored<Sse41Traits>, rk4RowStored<Sse41Traits>,
+                                          narrowRow<Sse41Traits>, speedRow<Sse41Traits>, traceLine<Sse41Traits>, rk4Line<Sse41Traits>,
+                                          sorLine<Sse41Traits>, gaussSeidelLine<Sse41Traits>};
+    return kernels;
+}
@@ -0,0 +1,144 @@
+#include "checkpoint.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+const char CHECKPOINT_MAGIC[8] = {'F', 'L', 'U', 'I', 'D', 'C', 'K', 'P'};
+
+std::uint64_t alignUp(std::uint64_t bytes)
+{
+    return (bytes + FIELD_ALIGNMENT - 1) / FIELD_ALIGNMENT * FIELD_ALIGNMENT;
+}
+
+void validate(const CheckpointHeader &header, std::size_t fileSize, const std::string &path)
+{
+    const char *problem = nullptr;
+    std::uint64_t fieldData = static_cast<std::uint64_t>(header.width) * header.stride * sizeof(float);
+    if (std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0)
+        problem = "not a fluid checkpoint";
+    else if (header.byteOrder != CHECKPOINT_BYTE_ORDER)
+        problem = "written with a different byte order";
+    else if (header.version != CHECKPOINT_VERSION)
+        problem = "unsupported version";
+    else if (header.width < 3 || header.height < 3 || header.stride < header.height ||
+             header.fieldCount != static_cast<std::uint32_t>(CHECKPOINT_FIELD_COUNT) ||
+             header.fieldOffset < sizeof(CheckpointHeader) || header.fieldOffset % FIELD_ALIGNMENT != 0 ||
+             header.fieldBytes < fieldData || header.fieldBytes % FIELD_ALIGNMENT != 0)
+        problem = "corrupt header";
+    // Divide rather than multiply, so huge sizes cannot wrap past the check
+    else if (header.fieldOffset > fileSize ||
+             header.fieldBytes > (fileSize - header.fieldOffset) / CHECKPOINT_FIELD_COUNT)
+        problem = "truncated";
+
+    if (problem)
+    {
+        throw std::runtime_error("Checkpoint " + path + ": " + problem);
+    }
+}
+}
+
+void writeCheckpoint(const std::string &path, const CheckpointHeader &header, const FieldView *fields)
+{
+    // Write beside the target and rename over it, so an interrupted save
+    // never leaves a truncated snapshot behind
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+        std::vector<char> padding(FIELD_ALIGNMENT, 0);
+        out.write(padding.data(), header.fieldOffset - sizeof(header));
+        for (std::uint32_t k = 0; k < header.fieldCount; k++)
+        {
+            std::size_t bytes = static_cast<std::size_t>(header.width) * header.stride * sizeof(float);
+            out.write(reinterpret_cast<const char *>(fields[k].data), bytes);
+            out.write(padding.data(), header.fieldBytes - bytes);
+        }
+
+        out.close();
+        if (!out)
+        {
+            std::remove(temporary.c_str());
+            throw std::runtime_error("Failed to write checkpoint " + path);
+        }
+    }
+
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("Failed to replace checkpoint " + path);
+    }
+}
+
+Checkpoint::Checkpoint(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Cannot open checkpoint " + path);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(CheckpointHeader))
+    {
+        close(fd);
+        throw std::runtime_error("Checkpoint " + path + ": truncated");
+    }
+
+    // The mapping stays valid after the descriptor is closed. It starts on a
+    // page boundary, so every aligned field offset is an aligned address.
+    mappingSize = static_cast<std::size_t>(info.st_size);
+    void *memory = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED)
+    {
+        throw std::runtime_error("Cannot map checkpoint " + path);
+    }
+    mapping = memory;
+
+    try
+    {
+        validate(getHeader(), mappingSize, path);
+    }
+    catch (...)
+    {
+        munmap(mapping, mappingSize);
+        throw;
+    }
+}
+
+Checkpoint::~Checkpoint()
+{
+    munmap(mapping, mappingSize);
+}
+
+FieldView Checkpoint::getField(CheckpointField field) const
+{
+    const CheckpointHeader &header = getHeader();
+    const char *base = static_cast<const char *>(mapping) + header.fieldOffset +
+                       static_cast<std::size_t>(field) * header.fieldBytes;
+    return {reinterpret_cast<const float *>(base), header.width, header.height, header.stride, 0};
+}
+
+CheckpointHeader makeCheckpointHeader(int width, int height, int stride)
+{
+    CheckpointHeader header = {};
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    header.version = CHECKPOINT_VERSION;
+    header.byteOrder = CHECKPOINT_BYTE_ORDER;
+    header.width = width;
+    header.height = height;
+    header.stride = stride;
+    header.fieldCount = CHECKPOINT_FIELD_COUNT;
+    header.fieldOffset = sizeof(CheckpointHeader);
+    header.fieldBytes = alignUp(static_cast<std::uint64_t>(width) * stride * sizeof(float));
+    return header;
+}
@@ -0,0 +1,107 @@
+#include "ensemble.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+
+EnsembleRunner::EnsembleRunner(int workerCount)
+    : scheduler(workerCount)
+{
+    for (int w = 0; w < scheduler.getWorkerCount(); w++)
+    {
+        sims.push_back(std::make_unique<FluidSim>(GRID_SIZE_X, GRID_SIZE_Y, 1));
+    }
+}
+
+std::vector<EnsembleResult> EnsembleRunner::run(const std::vector<EnsembleMember> &members, const Setup &setup,
+                                                const Force &force)
+{
+    std::vector<EnsembleResult> results(members.size());
+    scheduler.run(static_cast<int>(members.size()), [&](int worker, int index)
+    {
+        try
+        {
+            runMember(*sims[worker], members[index], index, setup, force, results[index]);
+        }
+        catch (const std::exception &e)
+        {
+            results[index].ok = false;
+            results[index].error = e.what();
+        }
+    });
+    return results;
+}
+
+void EnsembleRunner::runMember(FluidSim &sim, const EnsembleMember &member, int index, const Setup &setup,
+                               const Force &force, EnsembleResult &result)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // Parameters first: a snapshot brings its own noise seed
+    sim.setViscosity(member.viscosity);
+    sim.setDiffusion(member.diffusion);
+    sim.setAdvectionScheme(AdvectedField::Velocity, member.velocityScheme);
+    sim.setAdvectionScheme(AdvectedField::Density, member.densityScheme);
+    sim.setPressureSolver(member.solver);
+    sim.setTimestepSettings(member.timestep);
+    NoiseSettings noise = sim.getNoiseSettings();
+    noise.seed = member.seed;
+    sim.setNoiseSettings(noise);
+
+    // Keep the previous member's allocation when the size allows
+    if (!member.checkpointPath.empty())
+        sim.loadCheckpoint(member.checkpointPath);
+    else if (sim.getWidth() == member.width && sim.getHeight() == member.height)
+        sim.reset();
+    else
+        sim.resize(member.width, member.height);
+    // reset() and resize() keep the previous member's obstacles and emitters
+    sim.getObstacles().clear();
+    sim.clearEmitters();
+    sim.resetStats();
+
+    if (setup)
+        setup(sim, index);
+
+    std::unique_ptr<FieldRecorder> recorder;
+    if (!member.recordPath.empty())
+        recorder = std::make_unique<FieldRecorder>(member.recordPath, sim.getWidth(), sim.getHeight(), member.recorder);
+
+    for (int k = 0; k < member.steps; k++)
+    {
+        if (force)
+            force(sim, index, k);
+        sim.step(member.dt);
+        if (recorder)
+            recorder->offer(sim);
+    }
+    if (recorder)
+    {
+        recorder->close();
+        result.recordedFrames = recorder->getRecordedCount();
+    }
+
+    FieldView density = sim.getDensityView();
+    FieldView u = sim.getVelocityXView();
+    FieldView v = sim.getVelocityYView();
+    double totalDensity = 0.0, kineticEnergy = 0.0;
+    float maxSpeed = 0.0f;
+    for (int i = 1; i < sim.getWidth() - 1; i++)
+    {
+        for (int j = 1; j < sim.getHeight() - 1; j++)
+        {
+            std::size_t cell = static_cast<std::size_t>(i) * u.stride + j;
+            totalDensity += density.data[static_cast<std::size_t>(i) * density.stride + j];
+            kineticEnergy += 0.5 * (u.data[cell] * u.data[cell] + v.data[cell] * v.data[cell]);
+            maxSpeed = std::max(maxSpeed, std::max(std::abs(u.data[cell]), std::abs(v.data[cell])));
+        }
+    }
+
+    result.ok = true;
+    result.steps = member.steps;
+    result.totalDensity = totalDensity;
+    result.kineticEnergy = kineticEnergy;
+    result.maxSpeed = maxSpeed;
+    result.stats = sim.getStats();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
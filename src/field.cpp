@@ -0,0 +1,132 @@
+#include "field.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+int rowStride(int height, FieldLayout layout)
+{
+    if (layout != FieldLayout::PaddedRows)
+        return height;
+
+    // Whole cache lines, so every row starts aligned, plus one more when the
+    // row length is a multiple of 1 KiB: such strides map the cells of a
+    // column to a handful of sets, which gathers down a column then evict
+    const int lineFloats = static_cast<int>(FIELD_ALIGNMENT / sizeof(float));
+    int stride = (height + lineFloats - 1) / lineFloats * lineFloats;
+    if (stride % 256 == 0)
+        stride += lineFloats;
+    return stride;
+}
+
+Field::Field(int width, int height)
+{
+    resize(width, height);
+}
+
+void Field::resize(int newWidth, int newHeight, FieldLayout newLayout)
+{
+    if (newWidth <= 0 || newHeight <= 0)
+    {
+        throw std::invalid_argument("Field dimensions must be positive");
+    }
+    if (newLayout != FieldLayout::Rows && newLayout != FieldLayout::PaddedRows)
+    {
+        throw std::invalid_argument("Field stores rows only");
+    }
+
+    width = newWidth;
+    height = newHeight;
+    stride = rowStride(newHeight, newLayout);
+    layout = newLayout;
+
+    // aligned_alloc requires the size to be a multiple of the alignment
+    std::size_t bytes = getSize() * sizeof(float);
+    bytes = (bytes + FIELD_ALIGNMENT - 1) / FIELD_ALIGNMENT * FIELD_ALIGNMENT;
+
+    float *memory = static_cast<float *>(std::aligned_alloc(FIELD_ALIGNMENT, bytes));
+    if (!memory)
+    {
+        throw std::bad_alloc();
+    }
+    storage.reset(memory);
+    std::memset(memory, 0, bytes);
+}
+
+void Field::fill(float value)
+{
+    std::fill(storage.get(), storage.get() + getSize(), value);
+}
+
+void Field::copyFrom(const Field &other)
+{
+    if (other.width != width || other.height != height)
+    {
+        resize(other.width, other.height, other.layout);
+    }
+    copyFrom(other.view());
+}
+
+void Field::copyFrom(const FieldView &source)
+{
+    if (source.width != width || source.height != height)
+    {
+        resize(source.width, source.height, layout);
+    }
+    if (source.stride == stride)
+    {
+        std::memcpy(storage.get(), source.data, getSize() * sizeof(float));
+        return;
+    }
+    for (int x = 0; x < width; x++)
+    {
+        std::memcpy(row(x), source.data + static_cast<std::size_t>(x) * source.stride, height * sizeof(float));
+    }
+}
+
+// Set boundary conditions on the outer walls of a field
+template <int B>
+void applyBoundary(Field &x)
+{
+    int width = x.getWidth();
+    int height = x.getHeight();
+
+    // Walls
+    for (int i = 1; i < width - 1; i++)
+    {
+        x(i, 0) = B == 2 ? -x(i, 1) : x(i, 1);
+        x(i, height - 1) = B == 2 ? -x(i, height - 2) : x(i, height - 2);
+    }
+
+    for (int j = 1; j < height - 1; j++)
+    {
+        x(0, j) = B == 1 ? -x(1, j) : x(1, j);
+        x(width - 1, j) = B == 1 ? -x(width - 2, j) : x(width - 2, j);
+    }
+
+    // Corners
+    x(0, 0) = 0.5f * (x(1, 0) + x(0, 1));
+    x(0, height - 1) = 0.5f * (x(1, height - 1) + x(0, height - 2));
+    x(width - 1, 0) = 0.5f * (x(width - 2, 0) + x(width - 1, 1));
+    x(width - 1, height - 1) = 0.5f * (x(width - 2, height - 1) + x(width - 1, height - 2));
+}
+
+template void applyBoundary<0>(Field &x);
+template void applyBoundary<1>(Field &x);
+template void applyBoundary<2>(Field &x);
+
+void applyBoundary(int b, Field &x)
+{
+    switch (b)
+    {
+    case 1:
+        applyBoundary<1>(x);
+        break;
+    case 2:
+        applyBoundary<2>(x);
+        break;
+    default:
+        applyBoundary<0>(x);
+        break;
+    }
+}
@@ -0,0 +1,115 @@
+#include "field_export.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+// Source rows interleaved per pass of a transposed export
+const int TRANSPOSE_BLOCK = 32;
+
+void checkRegion(const FieldView &field, const FieldRegion &region, int pitch, ExportOrder order)
+{
+    if (region.width < 0 || region.height < 0 || region.x < field.firstRow || region.y < 0 ||
+        region.x + region.width > field.width || region.y + region.height > field.height)
+    {
+        throw std::invalid_argument("Export region lies outside the field");
+    }
+    int rowLength = order == ExportOrder::Native ? region.height : region.width;
+    if (pitch < rowLength)
+    {
+        throw std::invalid_argument("Export pitch is shorter than a row of the region");
+    }
+}
+
+const float *fieldRow(const FieldView &field, int x, int y)
+{
+    return field.data + static_cast<std::size_t>(x - field.firstRow) * field.stride + y;
+}
+
+void convertRow(const AdvectKernels &kernels, void *dest, const float *source, int count,
+                StoragePrecision precision)
+{
+    if (precision == StoragePrecision::Float32)
+        std::memcpy(dest, source, count * sizeof(float));
+    else
+        kernels.narrowRow(static_cast<std::uint16_t *>(dest), source, count, precision);
+}
+
+// Write the region from rowAt(x, slot), which returns region.height
+// contiguous values of source row x. Up to TRANSPOSE_BLOCK rows are live at
+// once, each in its own slot, so sources that compute rows need that many
+// buffers.
+template <typename RowSource>
+void exportRows(const RowSource &rowAt, const FieldRegion &region, void *dest, int pitch,
+                StoragePrecision precision, ExportOrder order, const AdvectKernels &kernels)
+{
+    unsigned char *bytes = static_cast<unsigned char *>(dest);
+    std::size_t cellSize = precision == StoragePrecision::Float32 ? sizeof(float) : sizeof(std::uint16_t);
+
+    if (order == ExportOrder::Native)
+    {
+        for (int x = 0; x < region.width; x++)
+        {
+            convertRow(kernels, bytes + static_cast<std::size_t>(x) * pitch * cellSize, rowAt(region.x + x, 0),
+                       region.height, precision);
+        }
+        return;
+    }
+
+    // A block of source rows at a time: every output row takes one cell from
+    // each, which stays in cache across the block
+    const float *rows[TRANSPOSE_BLOCK];
+    float column[TRANSPOSE_BLOCK];
+    for (int x0 = 0; x0 < region.width; x0 += TRANSPOSE_BLOCK)
+    {
+        int count = std::min(TRANSPOSE_BLOCK, region.width - x0);
+        for (int k = 0; k < count; k++)
+        {
+            rows[k] = rowAt(region.x + x0 + k, k);
+        }
+        for (int y = 0; y < region.height; y++)
+        {
+            for (int k = 0; k < count; k++)
+            {
+                column[k] = rows[k][y];
+            }
+            convertRow(kernels, bytes + (static_cast<std::size_t>(y) * pitch + x0) * cellSize, column, count,
+                       precision);
+        }
+    }
+}
+}
+
+void exportField(const FieldView &field, const FieldRegion &region, void *dest, int pitch,
+                 StoragePrecision precision, ExportOrder order, SimdLevel level)
+{
+    checkRegion(field, region, pitch, order);
+    if (region.width == 0 || region.height == 0)
+        return;
+
+    auto rowAt = [&](int x, int) { return fieldRow(field, x, region.y); };
+    exportRows(rowAt, region, dest, pitch, precision, order, getAdvectKernels(level));
+}
+
+void exportSpeed(const FieldView &u, const FieldView &v, const FieldRegion &region, void *dest, int pitch,
+                 StoragePrecision precision, ExportOrder order, SimdLevel level)
+{
+    checkRegion(u, region, pitch, order);
+    checkRegion(v, region, pitch, order);
+    if (region.width == 0 || region.height == 0)
+        return;
+
+    const AdvectKernels &kernels = getAdvectKernels(level);
+    int slots = order == ExportOrder::Native ? 1 : TRANSPOSE_BLOCK;
+    std::vector<float> speeds(static_cast<std::size_t>(slots) * region.height);
+    auto rowAt = [&](int x, int slot)
+    {
+        float *row = speeds.data() + static_cast<std::size_t>(slot) * region.height;
+        kernels.speedRow(row, fieldRow(u, x, region.y), fieldRow(v, x, region.y), region.height);
+        return static_cast<const float *>(row);
+    };
+    exportRows(rowAt, region, dest, pitch, precision, order, kernels);
+}
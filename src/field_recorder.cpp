@@ -0,0 +1,335 @@
+#include "field_recorder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+const char RECORDING_MAGIC[8] = {'F', 'L', 'U', 'I', 'D', 'R', 'E', 'C'};
+
+// Smallest and largest of n values. Four independent lanes keep the
+// comparisons from forming one long dependency chain.
+void rowRange(const float *row, int n, float &minimum, float &maximum)
+{
+    float low[4] = {minimum, minimum, minimum, minimum};
+    float high[4] = {maximum, maximum, maximum, maximum};
+    int y = 0;
+    for (; y + 4 <= n; y += 4)
+    {
+        for (int l = 0; l < 4; l++)
+        {
+            low[l] = row[y + l] < low[l] ? row[y + l] : low[l];
+            high[l] = row[y + l] > high[l] ? row[y + l] : high[l];
+        }
+    }
+    for (; y < n; y++)
+    {
+        low[0] = row[y] < low[0] ? row[y] : low[0];
+        high[0] = row[y] > high[0] ? row[y] : high[0];
+    }
+    minimum = std::min(std::min(low[0], low[1]), std::min(low[2], low[3]));
+    maximum = std::max(std::max(high[0], high[1]), std::max(high[2], high[3]));
+}
+
+// Quantise n values to codes of 8 * Bytes bits and store each as its
+// difference from the previous code, zigzag mapped so that 0, -1, 1, -2, ...
+// become 0, 1, 2, 3, ..., split into a low and (for 16 bits) a high byte
+// plane. referenceMask is 0 for keyframes, which are coded against zero.
+template <int Bytes>
+void encodeRow(const float *row, int n, float minimum, float inverse, std::uint32_t referenceMask,
+               std::uint16_t *previous, std::uint8_t *low, std::uint8_t *high)
+{
+    const int shift = 32 - 8 * Bytes;
+    const std::int32_t top = (1 << (8 * Bytes)) - 1;
+    for (int y = 0; y < n; y++)
+    {
+        std::int32_t code = std::min(static_cast<std::int32_t>((row[y] - minimum) * inverse + 0.5f), top);
+        // Difference modulo 2^bits, sign-extended from the top bit
+        std::uint32_t wrapped = (static_cast<std::uint32_t>(code) - (previous[y] & referenceMask)) << shift;
+        std::int32_t delta = static_cast<std::int32_t>(wrapped) >> shift;
+        std::uint32_t value = (static_cast<std::uint32_t>(delta) << 1) ^ static_cast<std::uint32_t>(delta >> 31);
+        previous[y] = static_cast<std::uint16_t>(code);
+        low[y] = static_cast<std::uint8_t>(value);
+        if (Bytes == 2)
+            high[y] = static_cast<std::uint8_t>(value >> 8);
+    }
+}
+
+template <int Bytes>
+void decodeRow(float *row, int n, float minimum, float scale, std::uint32_t referenceMask,
+               std::uint16_t *previous, const std::uint8_t *low, const std::uint8_t *high)
+{
+    const std::uint32_t mask = (1u << (8 * Bytes)) - 1;
+    for (int y = 0; y < n; y++)
+    {
+        std::uint32_t value = Bytes == 2 ? low[y] | (high[y] << 8) : low[y];
+        std::uint32_t delta = (value >> 1) ^ (0u - (value & 1));
+        std::uint32_t code = ((previous[y] & referenceMask) + delta) & mask;
+        previous[y] = static_cast<std::uint16_t>(code);
+        row[y] = minimum + code * scale;
+    }
+}
+}
+
+FieldRecorder::FieldRecorder(const std::string &path, int width, int height, const RecorderSettings &settings)
+    : settings(settings), width(width), height(height),
+      freeSlots(settings.queueFrames), readySlots(settings.queueFrames)
+{
+    if ((settings.bits != 8 && settings.bits != 16) || settings.interval < 1 || settings.keyframeInterval < 1 ||
+        settings.queueFrames < 1 || width < 1 || height < 1)
+    {
+        throw std::runtime_error("Invalid recorder settings");
+    }
+
+    out.open(path, std::ios::binary | std::ios::trunc);
+    RecordingHeader header = {};
+    std::memcpy(header.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+    header.version = RECORDING_VERSION;
+    header.byteOrder = RECORDING_BYTE_ORDER;
+    header.width = width;
+    header.height = height;
+    header.bits = settings.bits;
+    header.keyframeInterval = settings.keyframeInterval;
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    if (!out)
+    {
+        throw std::runtime_error("Cannot create recording " + path);
+    }
+    bytesWritten = sizeof(header);
+
+    // Allocate everything up front so recording never allocates per frame
+    slots.resize(settings.queueFrames);
+    for (int k = 0; k < settings.queueFrames; k++)
+    {
+        for (Field &field : slots[k].fields)
+        {
+            field.resize(width, height);
+        }
+        freeSlots.push(k);
+    }
+    std::size_t values = static_cast<std::size_t>(width) * height * RECORDING_FIELD_COUNT;
+    previousCodes.assign(values, 0);
+    planes.resize(values * (settings.bits / 8));
+
+    writer = std::thread(&FieldRecorder::run, this);
+}
+
+FieldRecorder::~FieldRecorder()
+{
+    try
+    {
+        close();
+    }
+    catch (const std::exception &)
+    {
+    }
+}
+
+bool FieldRecorder::offer(const FluidSim &sim)
+{
+    return offer(sim.getDensityView(), sim.getVelocityXView(), sim.getVelocityYView(), sim.getStepCount());
+}
+
+bool FieldRecorder::offer(const FieldView &density, const FieldView &velocityX, const FieldView &velocityY,
+                          std::uint64_t step)
+{
+    if (offered++ % settings.interval != 0)
+        return true;
+
+    const FieldView *views[RECORDING_FIELD_COUNT] = {&density, &velocityX, &velocityY};
+    for (const FieldView *view : views)
+    {
+        if (view->width != width || view->height != height)
+            throw std::invalid_argument("Recorded fields must match the recording size");
+    }
+
+    int index;
+    if (!running || !freeSlots.pop(index))
+    {
+        dropped++;
+        return false;
+    }
+
+    // The only work on the producer's thread: one memcpy per field
+    Slot &slot = slots[index];
+    for (int k = 0; k < RECORDING_FIELD_COUNT; k++)
+    {
+        slot.fields[k].copyFrom(*views[k]);
+    }
+    slot.step = step;
+    readySlots.push(index);
+    wake.notify_one();
+    return true;
+}
+
+void FieldRecorder::close()
+{
+    if (writer.joinable())
+    {
+        running = false;
+        wake.notify_one();
+        writer.join();
+    }
+    if (out.is_open())
+    {
+        out.close();
+        if (!out)
+            failed = true;
+    }
+    if (failed)
+    {
+        throw std::runtime_error("Failed to write recording");
+    }
+}
+
+void FieldRecorder::run()
+{
+    while (true)
+    {
+        int index;
+        if (readySlots.pop(index))
+        {
+            writeFrame(slots[index]);
+            freeSlots.push(index);
+            continue;
+        }
+
+        if (!running)
+        {
+            // Frames queued just before close() still go out
+            while (readySlots.pop(index))
+            {
+                writeFrame(slots[index]);
+            }
+            return;
+        }
+
+        // A notify can slip in between the empty pop and the wait, so the
+        // wait is bounded instead of taking a lock on every offer
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wake.wait_for(lock, std::chrono::milliseconds(2));
+    }
+}
+
+void FieldRecorder::writeFrame(const Slot &slot)
+{
+    if (failed)
+        return;
+
+    const std::uint32_t mask = (1u << settings.bits) - 1;
+    const std::size_t count = static_cast<std::size_t>(width) * height;
+    const int bytes = settings.bits / 8;
+
+    RecordedFrameHeader frame = {};
+    frame.step = slot.step;
+    frame.keyframe = framesSinceKeyframe == 0;
+    std::uint32_t referenceMask = frame.keyframe ? 0 : 0xffff;
+
+    for (int k = 0; k < RECORDING_FIELD_COUNT; k++)
+    {
+        const Field &field = slot.fields[k];
+        float minimum = field(0, 0), maximum = field(0, 0);
+        for (int x = 0; x < width; x++)
+        {
+            rowRange(field.row(x), height, minimum, maximum);
+        }
+        float scale = maximum > minimum ? (maximum - minimum) / mask : 0.0f;
+        float inverse = scale > 0.0f ? 1.0f / scale : 0.0f;
+        frame.minimum[k] = minimum;
+        frame.scale[k] = scale;
+
+        std::uint8_t *low = &planes[k * count * bytes];
+        for (int x = 0; x < width; x++)
+        {
+            std::size_t offset = static_cast<std::size_t>(x) * height;
+            std::uint16_t *previous = &previousCodes[k * count + offset];
+            if (bytes == 2)
+                encodeRow<2>(field.row(x), height, minimum, inverse, referenceMask, previous, low + offset, low + count + offset);
+            else
+                encodeRow<1>(field.row(x), height, minimum, inverse, referenceMask, previous, low + offset, nullptr);
+        }
+    }
+
+    compressor.compress(planes.data(), planes.size(), compressed);
+    frame.compressedBytes = static_cast<std::uint32_t>(compressed.size());
+    out.write(reinterpret_cast<const char *>(&frame), sizeof(frame));
+    out.write(reinterpret_cast<const char *>(compressed.data()), compressed.size());
+    if (!out)
+    {
+        failed = true;
+        return;
+    }
+
+    bytesWritten += sizeof(frame) + compressed.size();
+    recorded++;
+    framesSinceKeyframe = (framesSinceKeyframe + 1) % settings.keyframeInterval;
+}
+
+RecordingReader::RecordingReader(const std::string &path)
+    : in(path, std::ios::binary)
+{
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)))
+    {
+        throw std::runtime_error("Cannot read recording " + path);
+    }
+    if (std::memcmp(header.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) != 0 ||
+        header.byteOrder != RECORDING_BYTE_ORDER || header.version != RECORDING_VERSION ||
+        (header.bits != 8 && header.bits != 16) || header.width < 1 || header.height < 1)
+    {
+        throw std::runtime_error("Recording " + path + " is not a compatible fluid recording");
+    }
+    firstFrame = in.tellg();
+
+    std::size_t values = static_cast<std::size_t>(header.width) * header.height * RECORDING_FIELD_COUNT;
+    previousCodes.assign(values, 0);
+    planes.resize(values * (header.bits / 8));
+}
+
+bool RecordingReader::next(SimFrame &frame)
+{
+    // A recording cut short mid-frame simply ends at its last whole frame
+    RecordedFrameHeader record;
+    if (!in.read(reinterpret_cast<char *>(&record), sizeof(record)))
+        return false;
+    if (record.compressedBytes > planes.size() + planes.size() / 255 + 16)
+        throw std::runtime_error("Corrupt frame in recording");
+    compressed.resize(record.compressedBytes);
+    if (!in.read(reinterpret_cast<char *>(compressed.data()), compressed.size()))
+        return false;
+    if (!lzDecompress(compressed.data(), compressed.size(), planes.data(), planes.size()))
+        throw std::runtime_error("Corrupt frame in recording");
+
+    const std::size_t count = static_cast<std::size_t>(header.width) * header.height;
+    const int bytes = header.bits / 8;
+    std::uint32_t referenceMask = record.keyframe ? 0 : 0xffff;
+
+    Field *fields[RECORDING_FIELD_COUNT] = {&frame.density, &frame.velocityX, &frame.velocityY};
+    for (int k = 0; k < RECORDING_FIELD_COUNT; k++)
+    {
+        Field &field = *fields[k];
+        if (field.getWidth() != header.width || field.getHeight() != header.height)
+            field.resize(header.width, header.height);
+
+        const std::uint8_t *low = &planes[k * count * bytes];
+        for (int x = 0; x < header.width; x++)
+        {
+            std::size_t offset = static_cast<std::size_t>(x) * header.height;
+            std::uint16_t *previous = &previousCodes[k * count + offset];
+            if (bytes == 2)
+                decodeRow<2>(field.row(x), header.height, record.minimum[k], record.scale[k], referenceMask, previous,
+                             low + offset, low + count + offset);
+            else
+                decodeRow<1>(field.row(x), header.height, record.minimum[k], record.scale[k], referenceMask, previous,
+                             low + offset, nullptr);
+        }
+    }
+    frame.step = static_cast<long long>(record.step);
+    return true;
+}
+
+void RecordingReader::rewind()
+{
+    in.clear();
+    in.seekg(firstFrame);
+}
@@ -0,0 +1,836 @@
+// Headless benchmark for FluidSim::step
+//
+// Runs named, seeded scenarios for a fixed number of steps across grid sizes
+// and advection schemes, and prints one machine-readable record per run.
+//
+// Usage: fluid_bench [--steps N] [--warmup N] [--dt DT] [--seed S]
+//                    [--sizes 128,256,512] [--schemes sl,mc,rk4] [--solvers gs,mg,pcg]
+//                    [--scenarios blob,jet,puffs,obstacle] [--threads N] [--cfl C] [--sparse 0|1]
+//                    [--simd scalar,sse4.1,avx2,avx512] [--format csv|json]
+//                    [--trace trace.json] [--start warm.ckp] [--save warm.ckp]
+//                    [--record run.frec] [--record-every N] [--record-bits 8|16]
+//                    [--ensemble WORKERS] [--viscosity 0,1e-4] [--diffusion 0,1e-5] [--replicas N]
+//                    [--depth N] [--layout rows,padded,tiled,morton] [--warm-start 0|1]
+//                    [--tolerance T] [--check-every K] [--max-sweeps N]
+
+#include "ensemble.h"
+#include "field_recorder.h"
+#include "fluid_sim.h"
+#include "fluid_sim_3d.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+struct Scenario
+{
+    std::string name;
+    // Initial conditions, called once after the grid is reset
+    std::function<void(FluidSim &, std::mt19937 &)> setup;
+    // Optional per-step forcing, called before every step
+    std::function<void(FluidSim &, int)> force;
+};
+
+struct SchemeInfo
+{
+    std::string name;
+    AdvectionScheme scheme;
+};
+
+struct SolverInfo
+{
+    std::string name;
+    PressureSolver solver;
+};
+
+struct SimdInfo
+{
+    std::string name;
+    SimdLevel level;
+};
+
+struct LayoutInfo
+{
+    std::string name;
+    FieldLayout layout;
+};
+
+struct Options
+{
+    int steps = 200;
+    int warmup = 10;
+    float dt = 0.01f;
+    unsigned seed = 1;
+    int threads = 0; // 0 = one per hardware core
+    float cfl = 0.0f; // Target CFL number for adaptive substeps; 0 = fixed dt
+    bool sparse = false; // Skip inactive tiles
+    bool warmStart = false; // Start pressure solves from the last pressure
+    float tolerance = 0.0f; // Residual target of Gauss-Seidel, multigrid and diffusion; 0 = fixed counts
+    int checkInterval = 4;  // Sweeps between residual checks
+    int maxSweeps = 0;      // Gauss-Seidel pressure sweeps; 0 = the default 20
+    std::vector<int> sizes = {128, 256, 512};
+    std::vector<std::string> schemes = {"sl", "mc", "rk4"};
+    std::vector<std::string> solvers = {"gs"};
+    std::vector<std::string> simdLevels; // Empty = best available only
+    std::vector<std::string> layouts = {"rows"};
+    std::vector<std::string> scenarios = {"blob"};
+    bool json = false;
+    std::string tracePath; // Chrome trace of every measured step, if set
+    std::string startPath; // Snapshot every run starts from instead of setup and warmup
+    std::string savePath;  // Snapshot of the final state of each run, overwritten by the next
+    std::string recordPath; // Recording of the measured steps of each run, overwritten by the next
+    RecorderSettings recorder;
+
+    // Ensemble mode runs every combination, including the parameter lists
+    // below, as one batch of independent simulations
+    int ensembleWorkers = -1; // -1 = off, 0 = one per hardware core
+    std::vector<float> viscosities = {VISCOSITY};
+    std::vector<float> diffusions = {DIFFUSION};
+    int replicas = 1; // Copies of each combination, seeded seed, seed + 1, ...
+
+    int depth = 0; // Above 0, runs FluidSim3D on size x size x depth grids instead
+};
+
+// Add density and velocity to a disc of cells
+void addDisc(FluidSim &sim, int cx, int cy, int radius, float density, float vx, float vy)
+{
+    Splat splat;
+    splat.shape = SplatShape::Disc;
+    splat.x = static_cast<float>(cx);
+    splat.y = static_cast<float>(cy);
+    splat.radius = static_cast<float>(radius);
+    splat.density = density;
+    splat.velocityX = vx;
+    splat.velocityY = vy;
+    sim.addSplat(splat);
+}
+
+// Scales a length given for the 200x200 reference grid to the current grid
+int scaled(const FluidSim &sim, int cells)
+{
+    return std::max(1, cells * sim.getWidth() / GRID_SIZE_X);
+}
+
+std::vector<Scenario> makeScenarios()
+{
+    std::vector<Scenario> scenarios;
+
+    // The centred blob used by the interactive viewer
+    scenarios.push_back({"blob",
+                         [](FluidSim &sim, std::mt19937 &)
+                         {
+                             addDisc(sim, sim.getWidth() / 2, sim.getHeight() / 2, scaled(sim, 5), 10.0f, 0.0f, 2.0f);
+                         },
+                         nullptr});
+
+    // A continuous upward jet injected near the bottom wall
+    scenarios.push_back({"jet",
+                         nullptr,
+                         [](FluidSim &sim, int)
+                         {
+                             addDisc(sim, sim.getWidth() / 2, scaled(sim, 10), scaled(sim, 4), 1.0f, 0.0f, 0.5f);
+                         }});
+
+    // Randomly placed puffs moving in random directions
+    scenarios.push_back({"puffs",
+                         [](FluidSim &sim, std::mt19937 &rng)
+                         {
+                             std::uniform_real_distribution<float> position(0.2f, 0.8f);
+                             std::uniform_real_distribution<float> velocity(-2.0f, 2.0f);
+                             for (int k = 0; k < 8; k++)
+                             {
+                                 int cx = static_cast<int>(position(rng) * sim.getWidth());
+                                 int cy = static_cast<int>(position(rng) * sim.getHeight());
+                                 float vx = velocity(rng);
+                                 float vy = velocity(rng);
+                                 addDisc(sim, cx, cy, scaled(sim, 4), 5.0f, vx, vy);
+                             }
+                         },
+                         nullptr});
+
+    // The jet rising around a solid disc in the middle of the box
+    scenarios.push_back({"obstacle",
+                         [](FluidSim &sim, std::mt19937 &)
+                         {
+                             sim.getObstacles().fillDisc(sim.getWidth() / 2.0f, sim.getHeight() / 2.0f,
+                                                         static_cast<float>(scaled(sim, 20)), true);
+                         },
+                         [](FluidSim &sim, int)
+                         {
+                             addDisc(sim, sim.getWidth() / 2, scaled(sim, 10), scaled(sim, 4), 1.0f, 0.0f, 0.5f);
+                         }});
+
+    return scenarios;
+}
+
+const std::vector<SchemeInfo> &allSchemes()
+{
+    static const std::vector<SchemeInfo> schemes = {
+        {"sl", AdvectionScheme::SemiLagrangian},
+        {"mc", AdvectionScheme::MacCormack},
+        {"rk4", AdvectionScheme::RK4},
+    };
+    return schemes;
+}
+
+const std::vector<SolverInfo> &allSolvers()
+{
+    static const std::vector<SolverInfo> solvers = {
+        {"gs", PressureSolver::GaussSeidel},
+        {"mg", PressureSolver::Multigrid},
+        {"pcg", PressureSolver::ConjugateGradient},
+    };
+    return solvers;
+}
+
+const std::vector<LayoutInfo> &allLayouts()
+{
+    static const std::vector<LayoutInfo> layouts = {
+        {"rows", FieldLayout::Rows},
+        {"padded", FieldLayout::PaddedRows},
+        {"tiled", FieldLayout::Tiled},
+        {"morton", FieldLayout::Morton},
+    };
+    return layouts;
+}
+
+const std::vector<SimdInfo> &allSimdLevels()
+{
+    static const std::vector<SimdInfo> levels = {
+        {"scalar", SimdLevel::Scalar},
+        {"sse4.1", SimdLevel::SSE41},
+        {"avx2", SimdLevel::AVX2},
+        {"avx512", SimdLevel::AVX512},
+    };
+    return levels;
+}
+
+// Look up a named entry in one of the tables above
+template <typename Info>
+const Info *findByName(const std::vector<Info> &table, const std::string &name)
+{
+    for (const Info &candidate : table)
+    {
+        if (candidate.name == name)
+            return &candidate;
+    }
+    return nullptr;
+}
+
+std::vector<std::string> splitList(const std::string &text)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+bool parseOptions(int argc, char **argv, Options &options)
+{
+    for (int k = 1; k < argc; k++)
+    {
+        std::string arg = argv[k];
+        if (k + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        std::string value = argv[++k];
+
+        if (arg == "--steps")
+            options.steps = std::atoi(value.c_str());
+        else if (arg == "--warmup")
+            options.warmup = std::atoi(value.c_str());
+        else if (arg == "--dt")
+            options.dt = static_cast<float>(std::atof(value.c_str()));
+        else if (arg == "--seed")
+            options.seed = static_cast<unsigned>(std::strtoul(value.c_str(), nullptr, 10));
+        else if (arg == "--schemes")
+            options.schemes = splitList(value);
+        else if (arg == "--solvers")
+            options.solvers = splitList(value);
+        else if (arg == "--scenarios")
+            options.scenarios = splitList(value);
+        else if (arg == "--simd")
+            options.simdLevels = splitList(value);
+        else if (arg == "--cfl")
+            options.cfl = static_cast<float>(std::atof(value.c_str()));
+        else if (arg == "--sparse")
+            options.sparse = std::atoi(value.c_str()) != 0;
+        else if (arg == "--threads")
+            options.threads = std::atoi(value.c_str());
+        else if (arg == "--trace")
+            options.tracePath = value;
+        else if (arg == "--start")
+            options.startPath = value;
+        else if (arg == "--save")
+            options.savePath = value;
+        else if (arg == "--record")
+            options.recordPath = value;
+        else if (arg == "--record-every")
+            options.recorder.interval = std::atoi(value.c_str());
+        else if (arg == "--record-bits")
+            options.recorder.bits = std::atoi(value.c_str());
+        else if (arg == "--format")
+            options.json = value == "json";
+        else if (arg == "--ensemble")
+            options.ensembleWorkers = std::atoi(value.c_str());
+        else if (arg == "--viscosity" || arg == "--diffusion")
+        {
+            std::vector<float> &values = arg == "--viscosity" ? options.viscosities : options.diffusions;
+            values.clear();
+            for (const std::string &item : splitList(value))
+            {
+                values.push_back(static_cast<float>(std::atof(item.c_str())));
+            }
+        }
+        else if (arg == "--replicas")
+            options.replicas = std::atoi(value.c_str());
+        else if (arg == "--depth")
+        {
+            options.depth = std::atoi(value.c_str());
+            if (options.depth != 0 && options.depth < 3)
+            {
+                std::cerr << "Invalid depth " << value << ": use 0 for 2D or at least 3 cells" << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--layout")
+            options.layouts = splitList(value);
+        else if (arg == "--warm-start")
+            options.warmStart = std::atoi(value.c_str()) != 0;
+        else if (arg == "--tolerance")
+            options.tolerance = static_cast<float>(std::atof(value.c_str()));
+        else if (arg == "--check-every")
+            options.checkInterval = std::atoi(value.c_str());
+        else if (arg == "--max-sweeps")
+            options.maxSweeps = std::atoi(value.c_str());
+        else if (arg == "--sizes")
+        {
+            options.sizes.clear();
+            for (const std::string &size : splitList(value))
+            {
+                options.sizes.push_back(std::atoi(size.c_str()));
+                if (options.sizes.back() < 3)
+                {
+                    std::cerr << "Invalid size " << size << ": grids need at least 3 cells per side" << std::endl;
+                    return false;
+                }
+            }
+        }
+        else
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    return options.steps > 0 && options.warmup >= 0 && options.replicas > 0;
+}
+
+struct Result
+{
+    std::string scenario;
+    std::string scheme;
+    std::string solver;
+    std::string simd;
+    std::string layout;
+    int threads;
+    int width, height, steps;
+    double seconds;
+    double activeTiles; // Mean fraction of tiles active after each measured step
+    SimStats stats; // Measured steps only
+};
+
+void printResult(const Result &r, bool json)
+{
+    double cellSteps = static_cast<double>(r.width) * r.height * r.steps;
+    double stepsPerSecond = r.steps / r.seconds;
+    double nsPerCellStep = r.seconds * 1e9 / cellSteps;
+    double diffuseSeconds = r.stats[Stage::Diffuse].seconds;
+    double advectSeconds = r.stats[Stage::Advect].seconds;
+    double projectSeconds = r.stats[Stage::Project].seconds;
+    double otherSeconds = r.seconds - diffuseSeconds - advectSeconds - projectSeconds;
+    double pressureIterationsPerStep = static_cast<double>(r.stats.pressureIterations) / r.steps;
+    double diffusionIterationsPerStep = static_cast<double>(r.stats.diffusionIterations) / r.steps;
+
+    if (json)
+    {
+        std::cout << "{\"scenario\":\"" << r.scenario << "\",\"scheme\":\"" << r.scheme
+                  << "\",\"solver\":\"" << r.solver
+                  << "\",\"simd\":\"" << r.simd
+                  << "\",\"threads\":" << r.threads
+                  << ",\"width\":" << r.width << ",\"height\":" << r.height
+                  << ",\"steps\":" << r.steps << ",\"seconds\":" << r.seconds
+                  << ",\"steps_per_sec\":" << stepsPerSecond
+                  << ",\"ns_per_cell_step\":" << nsPerCellStep
+                  << ",\"diffuse_ms\":" << diffuseSeconds * 1e3
+                  << ",\"advect_ms\":" << advectSeconds * 1e3
+                  << ",\"project_ms\":" << projectSeconds * 1e3
+                  << ",\"boundary_ms\":" << r.stats[Stage::Boundary].seconds * 1e3
+                  << ",\"other_ms\":" << otherSeconds * 1e3
+                  << ",\"substeps_per_step\":" << static_cast<double>(r.stats.substeps) / r.steps
+                  << ",\"pressure_iters_per_step\":" << pressureIterationsPerStep
+                  << ",\"pressure_residual\":" << r.stats.worstPressureResidual
+                  << ",\"active_tiles\":" << r.activeTiles
+                  << ",\"layout\":\"" << r.layout
+                  << "\",\"diffusion_iters_per_step\":" << diffusionIterationsPerStep
+                  << ",\"diffusion_residual\":" << r.stats.worstDiffusionResidual << "}" << std::endl;
+    }
+    else
+    {
+        std::cout << r.scenario << "," << r.scheme << "," << r.solver << "," << r.simd << "," << r.threads << "," << r.width << "," << r.height << ","
+                  << r.steps << "," << r.seconds << "," << stepsPerSecond << "," << nsPerCellStep << ","
+                  << diffuseSeconds * 1e3 << "," << advectSeconds * 1e3 << "," << projectSeconds * 1e3 << ","
+                  << r.stats[Stage::Boundary].seconds * 1e3 << "," << otherSeconds * 1e3 << ","
+                  << static_cast<double>(r.stats.substeps) / r.steps << "," << pressureIterationsPerStep << "," << r.stats.worstPressureResidual << ","
+                  << r.activeTiles << "," << r.layout << "," << diffusionIterationsPerStep << "," << r.stats.worstDiffusionResidual << std::endl;
+    }
+}
+
+// Resolve a list of names against a table, reporting the first unknown one
+template <typename Info>
+bool resolveAll(const std::vector<Info> &table, const std::vector<std::string> &names, const char *what,
+                std::vector<const Info *> &resolved)
+{
+    for (const std::string &name : names)
+    {
+        const Info *info = findByName(table, name);
+        if (!info)
+        {
+            std::cerr << "Unknown " << what << " " << name << std::endl;
+            return false;
+        }
+        resolved.push_back(info);
+    }
+    return true;
+}
+
+// Run one configuration from a freshly seeded initial state; the grid size,
+// scheme, solver and kernels are already set on sim
+Result runScenario(FluidSim &sim, const Scenario &scenario, const Options &options, const Checkpoint *snapshot)
+{
+    sim.reset();
+    sim.getObstacles().clear();
+    NoiseSettings noise = sim.getNoiseSettings();
+    noise.seed = options.seed;
+    sim.setNoiseSettings(noise);
+    TimestepSettings timestep;
+    timestep.adaptive = options.cfl > 0.0f;
+    timestep.targetCfl = options.cfl;
+    sim.setTimestepSettings(timestep);
+    SparseSettings sparse;
+    sparse.enabled = options.sparse;
+    sim.setSparseSettings(sparse);
+    sim.setPressureWarmStart(options.warmStart);
+    RelaxationSettings gaussSeidel;
+    if (options.maxSweeps > 0)
+        gaussSeidel.maxIterations = options.maxSweeps;
+    gaussSeidel.tolerance = options.tolerance;
+    gaussSeidel.checkInterval = options.checkInterval;
+    sim.setGaussSeidelSettings(gaussSeidel);
+    RelaxationSettings diffusion = sim.getDiffusionSettings();
+    diffusion.tolerance = options.tolerance;
+    diffusion.checkInterval = options.checkInterval;
+    sim.setDiffusionSettings(diffusion);
+    MultigridSettings multigrid = sim.getMultigridSettings();
+    multigrid.tolerance = options.tolerance;
+    sim.setMultigridSettings(multigrid);
+    std::mt19937 rng(options.seed);
+    if (snapshot)
+    {
+        sim.loadCheckpoint(*snapshot);
+    }
+    else
+    {
+        if (scenario.setup)
+            scenario.setup(sim, rng);
+
+        for (int k = 0; k < options.warmup; k++)
+        {
+            if (scenario.force)
+                scenario.force(sim, k);
+            sim.step(options.dt);
+        }
+    }
+
+    // Recording runs alongside the measured steps, so its cost is included
+    std::unique_ptr<FieldRecorder> recorder;
+    if (!options.recordPath.empty())
+        recorder = std::make_unique<FieldRecorder>(options.recordPath, sim.getWidth(), sim.getHeight(), options.recorder);
+
+    Result result;
+    result.activeTiles = 0.0;
+    sim.resetStats();
+    if (!options.tracePath.empty())
+        sim.getTrace().start();
+    auto start = std::chrono::steady_clock::now();
+    for (int k = 0; k < options.steps; k++)
+    {
+        if (scenario.force)
+            scenario.force(sim, options.warmup + k);
+        sim.step(options.dt);
+        if (recorder)
+            recorder->offer(sim);
+        const TileMask &tiles = sim.getActiveTiles();
+        result.activeTiles += static_cast<double>(tiles.getActiveCount()) / (tiles.getTilesX() * tiles.getTilesY());
+    }
+    sim.getTrace().stop();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    result.scenario = scenario.name;
+    result.simd = getAdvectKernels(sim.getSimdLevel()).name;
+    result.threads = sim.getThreadCount();
+    result.width = sim.getWidth();
+    result.height = sim.getHeight();
+    result.steps = options.steps;
+    result.activeTiles /= options.steps;
+    if (recorder)
+    {
+        recorder->close();
+        std::cerr << "Recorded " << recorder->getRecordedCount() << " frames (" << recorder->getDroppedCount()
+                  << " dropped), " << recorder->getBytesWritten() / 1e6 << " MB" << std::endl;
+    }
+    result.stats = sim.getStats();
+    return result;
+}
+}
+
+// Run every combination of the listed scenarios, sizes, schemes, solvers,
+// viscosities and diffusion rates, times the replicas, as one ensemble batch
+// and print one record per member. Warmup, SIMD and threading options do not
+// apply: members are single-threaded and run side by side.
+int runEnsemble(const Options &options, const std::vector<const Scenario *> &scenarios,
+                const std::vector<const SchemeInfo *> &schemes, const std::vector<const SolverInfo *> &solvers)
+{
+    struct Label
+    {
+        const Scenario *scenario;
+        const SchemeInfo *scheme;
+        const SolverInfo *solver;
+    };
+
+    std::vector<EnsembleMember> members;
+    std::vector<Label> labels;
+    for (const Scenario *scenario : scenarios)
+        for (int size : options.sizes)
+            for (const SchemeInfo *scheme : schemes)
+                for (const SolverInfo *solver : solvers)
+                    for (float viscosity : options.viscosities)
+                        for (float diffusion : options.diffusions)
+                            for (int replica = 0; replica < options.replicas; replica++)
+                            {
+                                EnsembleMember member;
+                                member.width = size;
+                                member.height = size;
+                                member.viscosity = viscosity;
+                                member.diffusion = diffusion;
+                                member.velocityScheme = scheme->scheme;
+                                member.densityScheme = scheme->scheme;
+                                member.solver = solver->solver;
+                                member.timestep.adaptive = options.cfl > 0.0f;
+                                member.timestep.targetCfl = options.cfl;
+                                member.seed = options.seed + replica;
+                                member.dt = options.dt;
+                                member.steps = options.steps;
+                                members.push_back(member);
+                                labels.push_back({scenario, scheme, solver});
+                            }
+
+    EnsembleRunner runner(options.ensembleWorkers);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<EnsembleResult> results = runner.run(
+        members,
+        [&](FluidSim &sim, int index)
+        {
+            std::mt19937 rng(members[index].seed);
+            if (labels[index].scenario->setup)
+                labels[index].scenario->setup(sim, rng);
+        },
+        [&](FluidSim &sim, int index, int step)
+        {
+            if (labels[index].scenario->force)
+                labels[index].scenario->force(sim, step);
+        });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!options.json)
+    {
+        std::cout << "scenario,scheme,solver,width,height,viscosity,diffusion,seed,steps,seconds,steps_per_sec,"
+                     "total_density,kinetic_energy,max_speed,error"
+                  << std::endl;
+    }
+    long long totalSteps = 0;
+    int failures = 0;
+    for (std::size_t k = 0; k < members.size(); k++)
+    {
+        const EnsembleMember &m = members[k];
+        const EnsembleResult &r = results[k];
+        totalSteps += r.steps;
+        failures += r.ok ? 0 : 1;
+        double stepsPerSecond = r.seconds > 0.0 ? r.steps / r.seconds : 0.0;
+        if (options.json)
+        {
+            std::cout << "{\"scenario\":\"" << labels[k].scenario->name << "\",\"scheme\":\"" << labels[k].scheme->name
+                      << "\",\"solver\":\"" << labels[k].solver->name << "\",\"width\":" << m.width
+                      << ",\"height\":" << m.height << ",\"viscosity\":" << m.viscosity
+                      << ",\"diffusion\":" << m.diffusion << ",\"seed\":" << m.seed << ",\"steps\":" << r.steps
+                      << ",\"seconds\":" << r.seconds << ",\"steps_per_sec\":" << stepsPerSecond
+                      << ",\"total_density\":" << r.totalDensity << ",\"kinetic_energy\":" << r.kineticEnergy
+                      << ",\"max_speed\":" << r.maxSpeed << ",\"error\":\"" << r.error << "\"}" << std::endl;
+        }
+        else
+        {
+            std::cout << labels[k].scenario->name << "," << labels[k].scheme->name << "," << labels[k].solver->name << ","
+                      << m.width << "," << m.height << "," << m.viscosity << "," << m.diffusion << "," << m.seed << ","
+                      << r.steps << "," << r.seconds << "," << stepsPerSecond << "," << r.totalDensity << ","
+                      << r.kineticEnergy << "," << r.maxSpeed << "," << r.error << std::endl;
+        }
+    }
+
+    std::cerr << members.size() << " members on " << runner.getWorkerCount() << " workers: " << totalSteps / seconds
+              << " steps/sec across the batch, " << runner.getStealCount() << " members stolen" << std::endl;
+    return failures > 0 ? 1 : 0;
+}
+
+// Time FluidSim3D over the listed sizes, schemes and SIMD levels with a
+// rising jet of density through the middle of the volume. Scenarios,
+// solvers and the 2D-only options do not apply.
+int runVolume(const Options &options, const std::vector<const SchemeInfo *> &schemes,
+              const std::vector<const SimdInfo *> &simdLevels)
+{
+    if (!options.json)
+    {
+        std::cout << "scheme,simd,threads,width,height,depth,steps,seconds,steps_per_sec,ns_per_cell_step,total_density"
+                  << std::endl;
+    }
+
+    FluidSim3D sim(GRID_SIZE_Z, GRID_SIZE_Z, GRID_SIZE_Z, options.threads);
+    for (int size : options.sizes)
+    {
+        sim.resize(size, size, options.depth);
+        for (const SchemeInfo *scheme : schemes)
+        {
+            for (const SimdInfo *simd : simdLevels)
+            {
+                if (static_cast<int>(simd->level) > static_cast<int>(bestSimdLevel()))
+                {
+                    std::cerr << "Skipping " << simd->name << ": not supported on this machine" << std::endl;
+                    continue;
+                }
+                sim.setAdvectionScheme(scheme->scheme);
+                sim.setSimdLevel(simd->level);
+                sim.reset();
+
+                int radius = std::max(1, size / 16);
+                auto force = [&]()
+                {
+                    for (int x = size / 2 - radius; x <= size / 2 + radius; x++)
+                    {
+                        for (int z = options.depth / 2 - radius; z <= options.depth / 2 + radius; z++)
+                        {
+                            sim.addDensity(x, 2, z, 1.0f);
+                            sim.addVelocity(x, 2, z, 0.0f, 2.0f, 0.0f);
+                        }
+                    }
+                };
+
+                for (int k = 0; k < options.warmup; k++)
+                {
+                    force();
+                    sim.step(options.dt);
+                }
+                auto start = std::chrono::steady_clock::now();
+                for (int k = 0; k < options.steps; k++)
+                {
+                    force();
+                    sim.step(options.dt);
+                }
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                VolumeView density = sim.getDensityView();
+                double totalDensity = 0.0;
+                for (int x = 1; x < size - 1; x++)
+                {
+                    for (int y = 1; y < size - 1; y++)
+                    {
+                        const float *line = density.data + static_cast<std::size_t>(x) * density.sliceStride +
+                                            static_cast<std::size_t>(y) * density.lineStride;
+                        for (int z = 1; z < options.depth - 1; z++)
+                        {
+                            totalDensity += line[z];
+                        }
+                    }
+                }
+
+                double cells = static_cast<double>(size) * size * options.depth;
+                double stepsPerSecond = options.steps / seconds;
+                double nsPerCellStep = seconds * 1e9 / (cells * options.steps);
+                if (options.json)
+                {
+                    std::cout << "{\"scheme\":\"" << scheme->name << "\",\"simd\":\"" << simd->name
+                              << "\",\"threads\":" << sim.getThreadCount() << ",\"width\":" << size
+                              << ",\"height\":" << size << ",\"depth\":" << options.depth
+                              << ",\"steps\":" << options.steps << ",\"seconds\":" << seconds
+                              << ",\"steps_per_sec\":" << stepsPerSecond << ",\"ns_per_cell_step\":" << nsPerCellStep
+                              << ",\"total_density\":" << totalDensity << "}" << std::endl;
+                }
+                else
+                {
+                    std::cout << scheme->name << "," << simd->name << "," << sim.getThreadCount() << "," << size << ","
+                              << size << "," << options.depth << "," << options.steps << "," << seconds << ","
+                              << stepsPerSecond << "," << nsPerCellStep << "," << totalDensity << std::endl;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        std::cerr << "Usage: fluid_bench [--steps N] [--warmup N] [--dt DT] [--seed S] "
+                     "[--sizes 128,256] [--schemes sl,mc,rk4] [--solvers gs,mg,pcg] [--scenarios blob,jet,puffs,obstacle] "
+                     "[--threads N] [--cfl C] [--sparse 0|1] [--simd scalar,sse4.1,avx2,avx512] [--format csv|json] [--trace FILE] "
+                     "[--start FILE] [--save FILE] [--record FILE] [--record-every N] [--record-bits 8|16] "
+                     "[--ensemble WORKERS] [--viscosity LIST] [--diffusion LIST] [--replicas N] [--depth N] "
+                     "[--layout rows,padded,tiled,morton] "
+                     "[--warm-start 0|1] [--tolerance T] [--check-every K] [--max-sweeps N]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::vector<Scenario> scenarioTable = makeScenarios();
+    std::vector<const Scenario *> scenarios;
+    std::vector<const SchemeInfo *> schemes;
+    std::vector<const SolverInfo *> solvers;
+    std::vector<const SimdInfo *> simdLevels;
+    std::vector<const LayoutInfo *> layouts;
+    if (!resolveAll(allLayouts(), options.layouts, "layout", layouts) ||
+        !resolveAll(scenarioTable, options.scenarios, "scenario", scenarios) ||
+        !resolveAll(allSchemes(), options.schemes, "advection scheme", schemes) ||
+        !resolveAll(allSolvers(), options.solvers, "pressure solver", solvers) ||
+        !resolveAll(allSimdLevels(), options.simdLevels, "SIMD level", simdLevels))
+    {
+        return 1;
+    }
+    if (simdLevels.empty())
+    {
+        // Default to the best kernels this machine supports
+        for (const SimdInfo &info : allSimdLevels())
+        {
+            if (info.level == bestSimdLevel())
+                simdLevels.push_back(&info);
+        }
+    }
+
+    if (options.depth > 0)
+        return runVolume(options, schemes, simdLevels);
+    if (options.ensembleWorkers >= 0)
+        return runEnsemble(options, scenarios, schemes, solvers);
+
+    // A starting snapshot fixes the grid size
+    std::unique_ptr<Checkpoint> start;
+    if (!options.startPath.empty())
+    {
+        try
+        {
+            start = std::make_unique<Checkpoint>(options.startPath);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        options.sizes = {start->getHeader().width};
+    }
+
+    if (!options.json)
+    {
+        std::cout << "scenario,scheme,solver,simd,threads,width,height,steps,seconds,steps_per_sec,ns_per_cell_step,"
+                     "diffuse_ms,advect_ms,project_ms,boundary_ms,other_ms,substeps_per_step,pressure_iters_per_step,pressure_residual,"
+                     "active_tiles,layout,diffusion_iters_per_step,diffusion_residual"
+                  << std::endl;
+    }
+
+    FluidSim sim(GRID_SIZE_X, GRID_SIZE_Y, options.threads);
+    for (const Scenario *scenario : scenarios)
+    {
+        for (int size : options.sizes)
+        {
+            if (!start)
+                sim.resize(size, size);
+            for (const SchemeInfo *scheme : schemes)
+            {
+                for (const SolverInfo *solver : solvers)
+                {
+                    for (const SimdInfo *simd : simdLevels)
+                    {
+                        if (static_cast<int>(simd->level) > static_cast<int>(bestSimdLevel()))
+                        {
+                            std::cerr << "Skipping " << simd->name << ": not supported on this machine" << std::endl;
+                            continue;
+                        }
+
+                        sim.setAdvectionScheme(scheme->scheme);
+                        sim.setPressureSolver(solver->solver);
+                        sim.setSimdLevel(simd->level);
+
+                        for (const LayoutInfo *layout : layouts)
+                        {
+                            sim.setFieldLayout(layout->layout);
+
+                            // Checkpoint and recording files can fail to open or write
+                            try
+                            {
+                                Result result = runScenario(sim, *scenario, options, start.get());
+                                result.scheme = scheme->name;
+                                result.solver = solver->name;
+                                result.layout = layout->name;
+                                printResult(result, options.json);
+
+                                if (!options.savePath.empty())
+                                    sim.saveCheckpoint(options.savePath);
+                            }
+                            catch (const std::exception &e)
+                            {
+                                std::cerr << e.what() << std::endl;
+                                return 1;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if (!options.tracePath.empty())
+    {
+        std::ofstream trace(options.tracePath);
+        writeChromeTrace(trace, sim.getTrace().getEvents());
+        if (!trace)
+        {
+            std::cerr << "Failed to write " << options.tracePath << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
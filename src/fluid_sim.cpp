@@ -1,431 +1,1068 @@
 #include "fluid_sim.h"
 #include <iostream>
+#include <stdexcept>
+#include <chrono>
+#include <cstring>
 
-FluidSim::FluidSim() : width(GRID_SIZE_X), height(GRID_SIZE_Y)
+namespace
 {
-    // Initialize the grid
-    for (int i = 0; i < width; i++)
+// Adds the lifetime of the enclosing scope, one call and a cell count to a
+// stage, and logs the span while the trace is recording. Empty when the
+// build defines FLUID_SIM_NO_INSTRUMENTATION.
+class ScopedStage
+{
+public:
+#ifndef FLUID_SIM_NO_INSTRUMENTATION
+    ScopedStage(SimStats &stats, TraceRecorder &trace, Stage stage, long long cells)
+        : total(stats[stage]), trace(trace), stage(stage), start(std::chrono::steady_clock::now())
+    {
+        total.calls++;
+        total.cells += cells;
+    }
+
+    // Count cells known only once the stage has run
+    void addCells(long long cells) { total.cells += cells; }
+
+    ~ScopedStage()
+    {
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        total.seconds += std::chrono::duration<double>(end - start).count();
+        if (trace.isRecording())
+            trace.record(stage, start, end);
+    }
+
+private:
+    StageStats &total;
+    TraceRecorder &trace;
+    Stage stage;
+    std::chrono::steady_clock::time_point start;
+#else
+    ScopedStage(SimStats &, TraceRecorder &, Stage, long long) {}
+    void addCells(long long) {}
+#endif
+};
+
+// Run up to settings.maxIterations calls of sweep(). With a tolerance set,
+// stop as soon as residual() meets it, checking before the first sweep,
+// every checkInterval sweeps and after the last.
+template <typename Sweep, typename Residual>
+SolverStats relax(const RelaxationSettings &settings, Sweep sweep, Residual residual)
+{
+    SolverStats result;
+    bool monitored = settings.tolerance > 0.0f;
+    int interval = std::max(1, settings.checkInterval);
+    if (monitored)
     {
-        for (int j = 0; j < height; j++)
+        result.residual = residual();
+        if (result.residual <= settings.tolerance)
+            return result;
+    }
+    while (result.iterations < settings.maxIterations)
+    {
+        sweep();
+        result.iterations++;
+        if (monitored && (result.iterations % interval == 0 || result.iterations == settings.maxIterations))
         {
-            density[i][j] = 0.0f;
-            velocityX[i][j] = 0.0f;
-            velocityY[i][j] = 0.0f;
-            prevDensity[i][j] = 0.0f;
-            prevVelocityX[i][j] = 0.0f;
-            prevVelocityY[i][j] = 0.0f;
-            tempField1[i][j] = 0.0f;
-            tempField2[i][j] = 0.0f;
+            result.residual = residual();
+            if (result.residual <= settings.tolerance)
+                break;
         }
     }
+    return result;
 }
 
-void FluidSim::step(float dt)
+// Residual norm relative to the right-hand side's, or absolute when that is
+// zero
+inline float relativeResidual(float residual, float rhsNorm)
 {
-    // Perform velocity and density steps
-    velocityStep(dt);
-    densityStep(dt);
+    return rhsNorm > 0.0f ? residual / rhsNorm : residual;
 }
 
-// Add source terms to the density/velocity fields
-void FluidSim::addSource(float dest[GRID_SIZE_X][GRID_SIZE_Y], const float source[GRID_SIZE_X][GRID_SIZE_Y], float dt)
+// Working set one MacCormack tile aims to keep in L2
+const std::size_t MACCORMACK_TILE_BYTES = 256 * 1024;
+
+// Ghost cells at both ends of an interior row, as applyBoundary<B> sets them
+template <int B>
+inline void fillGhostColumns(float *row, int height)
 {
-    for (int i = 0; i < width; i++)
+    row[0] = B == 2 ? -row[1] : row[1];
+    row[height - 1] = B == 2 ? -row[height - 2] : row[height - 2];
+}
+
+// Ghost row next to the interior row inner, whose ghost columns are set,
+// including the corners, as applyBoundary<B> sets them
+template <int B>
+inline void fillGhostRow(float *ghost, const float *inner, int height)
+{
+    for (int j = 1; j < height - 1; j++)
     {
-        for (int j = 0; j < height; j++)
-        {
-            dest[i][j] += dt * source[i][j];
-        }
+        ghost[j] = B == 1 ? -inner[j] : inner[j];
     }
+    ghost[0] = 0.5f * (inner[0] + ghost[1]);
+    ghost[height - 1] = 0.5f * (inner[height - 1] + ghost[height - 2]);
+}
 }
 
-// Diffuse the field using Gauss-Seidel relaxation
-void FluidSim::diffuse(int b, float dest[GRID_SIZE_X][GRID_SIZE_Y], const float source[GRID_SIZE_X][GRID_SIZE_Y], float diff, float dt)
+FluidSim::FluidSim(int width, int height, int threadCount)
 {
-    float a = dt * diff * width * height;
-    float cRecip = 1.0f / (1 + 4 * a);
-    float omega = 1.5f; // Relaxation parameter for SOR
+    setThreadCount(threadCount);
+    resize(width, height);
+}
+
+void FluidSim::setSimdLevel(SimdLevel level)
+{
+    advectKernels = &getAdvectKernels(level);
+}
+
+void FluidSim::setAdvectionScheme(AdvectionScheme scheme)
+{
+    velocityScheme = scheme;
+    densityScheme = scheme;
+}
+
+void FluidSim::setAdvectionScheme(AdvectedField field, AdvectionScheme scheme)
+{
+    (field == AdvectedField::Velocity ? velocityScheme : densityScheme) = scheme;
+}
+
+AdvectionScheme FluidSim::getAdvectionScheme(AdvectedField field) const
+{
+    return field == AdvectedField::Velocity ? velocityScheme : densityScheme;
+}
 
-    // Successive Over-Relaxation
-    for (int k = 0; k < 5; k++)
-    { // 20 iterations for stability
-        for (int i = 1; i < width - 1; i++)
+void FluidSim::setFieldLayout(FieldLayout layout)
+{
+    fieldLayout = layout;
+    for (Field *field : gridFields())
+    {
+        if (field->getLayout() != rowLayout())
         {
-            for (int j = 1; j < height - 1; j++)
-            {
-                float newValue = (source[i][j] + a * (dest[i + 1][j] + dest[i - 1][j] + dest[i][j + 1] + dest[i][j - 1])) * cRecip;
-                dest[i][j] = dest[i][j] + omega * (newValue - dest[i][j]);
-            }
+            Field moved;
+            moved.resize(width, height, rowLayout());
+            moved.copyFrom(field->view());
+            *field = std::move(moved);
         }
-        setBoundary(b, dest);
     }
 }
 
-// Semi-Lagrangian advection (original method)
-void FluidSim::semiLagrangianAdvect(int b, float dest[GRID_SIZE_X][GRID_SIZE_Y], const float source[GRID_SIZE_X][GRID_SIZE_Y],
-                                    const float u[GRID_SIZE_X][GRID_SIZE_Y], const float v[GRID_SIZE_X][GRID_SIZE_Y], float dt)
+void FluidSim::setThreadCount(int threadCount)
 {
-    float dt0 = dt * width;
+    threadPool = std::make_unique<ThreadPool>(threadCount);
+    macCormackWindows.clear();
+    macCormackWindows.resize(threadPool->getThreadCount());
+    multigrid.setThreadPool(threadPool.get());
+    conjugateGradient.setThreadPool(threadPool.get());
+}
+
+int FluidSim::getThreadCount() const
+{
+    return threadPool->getThreadCount();
+}
 
-    for (int i = 1; i < width - 1; i++)
+void FluidSim::resize(int newWidth, int newHeight)
+{
+    if (newWidth < 3 || newHeight < 3)
     {
-        for (int j = 1; j < height - 1; j++)
-        {
-            // Trace particle position backward
-            float x = i - dt0 * u[i][j];
-            float y = j - dt0 * v[i][j];
-
-            // Clamp to grid bounds
-            x = std::max(0.5f, std::min(width - 1.5f, x));
-            y = std::max(0.5f, std::min(height - 1.5f, y));
-
-            // Find grid cell indices
-            int i0 = static_cast<int>(x);
-            int i1 = i0 + 1;
-            int j0 = static_cast<int>(y);
-            int j1 = j0 + 1;
-
-            // Bilinear interpolation weights
-            float s1 = x - i0;
-            float s0 = 1 - s1;
-            float t1 = y - j0;
-            float t0 = 1 - t1;
-
-            // Bilinear interpolation
-            dest[i][j] = s0 * (t0 * source[i0][j0] + t1 * source[i0][j1]) +
-                         s1 * (t0 * source[i1][j0] + t1 * source[i1][j1]);
-        }
+        throw std::invalid_argument("FluidSim grid must be at least 3x3 cells");
+    }
+
+    width = newWidth;
+    height = newHeight;
+
+    // Fields are allocated zero-initialized
+    for (Field *field : gridFields())
+    {
+        field->resize(width, height, rowLayout());
     }
-    setBoundary(b, dest);
+    obstacles.resize(width, height);
+    conjugateGradient.setObstacles(nullptr);
+    multigrid.resize(width, height);
+    conjugateGradient.resize(width, height);
+    activeTiles.resize(width, height);
+    splatTiles.resize(width, height);
+    pendingSplats.clear();
+    noiseStep = 0;
+    stepCount = 0;
 }
 
-// MacCormack advection method - more accurate, reduces numerical diffusion
-void FluidSim::macCormackAdvect(int b, float dest[GRID_SIZE_X][GRID_SIZE_Y], const float source[GRID_SIZE_X][GRID_SIZE_Y],
-                                const float u[GRID_SIZE_X][GRID_SIZE_Y], const float v[GRID_SIZE_X][GRID_SIZE_Y], float dt)
+void FluidSim::reset()
 {
-    float dt0 = dt * width;
+    noiseStep = 0;
+    stepCount = 0;
+    pendingSplats.clear();
 
-    // Step 1: Forward advection (predictor step)
-    // Use semi-Lagrangian method to advect forward
-    for (int i = 1; i < width - 1; i++)
+    // Clear the grid in place, keeping the current allocation
+    for (Field *field : gridFields())
     {
-        for (int j = 1; j < height - 1; j++)
-        {
-            // Trace particle position backward
-            float x = i - dt0 * u[i][j];
-            float y = j - dt0 * v[i][j];
-
-            // Clamp to grid bounds
-            x = std::max(0.5f, std::min(width - 1.5f, x));
-            y = std::max(0.5f, std::min(height - 1.5f, y));
-
-            // Find grid cell indices
-            int i0 = static_cast<int>(x);
-            int i1 = i0 + 1;
-            int j0 = static_cast<int>(y);
-            int j1 = j0 + 1;
-
-            // Bilinear interpolation weights
-            float s1 = x - i0;
-            float s0 = 1 - s1;
-            float t1 = y - j0;
-            float t0 = 1 - t1;
-
-            // Bilinear interpolation - store in tempField1
-            tempField1[i][j] = s0 * (t0 * source[i0][j0] + t1 * source[i0][j1]) +
-                               s1 * (t0 * source[i1][j0] + t1 * source[i1][j1]);
-        }
+        field->fill(0.0f);
     }
-    setBoundary(b, tempField1);
+}
+
+// Only the current fields and the pressures persist between steps; the prev
+// fields are rewritten before every read, so they are left out of snapshots
+void FluidSim::saveCheckpoint(const std::string &path) const
+{
+    CheckpointHeader header = makeCheckpointHeader(width, height, density.getStride());
+    header.stepCount = stepCount;
+    header.noiseSeed = noiseSettings.seed;
+    header.noiseStep = noiseStep;
+
+    FieldView fields[CHECKPOINT_FIELD_COUNT] = {density.view(), velocityX.view(), velocityY.view(),
+                                                diffusedPressure.view(), advectedPressure.view()};
+    writeCheckpoint(path, header, fields);
+}
 
-    // Step 2: Backward advection (corrector step)
-    // Advect the result from step 1 backward in time
-    for (int i = 1; i < width - 1; i++)
+void FluidSim::loadCheckpoint(const Checkpoint &checkpoint)
+{
+    const CheckpointHeader &header = checkpoint.getHeader();
+    if (header.width != width || header.height != height)
     {
-        for (int j = 1; j < height - 1; j++)
-        {
-            // Trace particle position forward (opposite direction)
-            float x = i + dt0 * u[i][j];
-            float y = j + dt0 * v[i][j];
-
-            // Clamp to grid bounds
-            x = std::max(0.5f, std::min(width - 1.5f, x));
-            y = std::max(0.5f, std::min(height - 1.5f, y));
-
-            // Find grid cell indices
-            int i0 = static_cast<int>(x);
-            int i1 = i0 + 1;
-            int j0 = static_cast<int>(y);
-            int j1 = j0 + 1;
-
-            // Bilinear interpolation weights
-            float s1 = x - i0;
-            float s0 = 1 - s1;
-            float t1 = y - j0;
-            float t0 = 1 - t1;
-
-            // Bilinear interpolation - store in tempField2
-            tempField2[i][j] = s0 * (t0 * tempField1[i0][j0] + t1 * tempField1[i0][j1]) +
-                               s1 * (t0 * tempField1[i1][j0] + t1 * tempField1[i1][j1]);
-        }
+        resize(header.width, header.height);
     }
-    setBoundary(b, tempField2);
 
-    // Step 3: Calculate error and apply correction
-    for (int i = 1; i < width - 1; i++)
+    // One memcpy per field while the strides match
+    density.copyFrom(checkpoint.getField(CheckpointField::Density));
+    velocityX.copyFrom(checkpoint.getField(CheckpointField::VelocityX));
+    velocityY.copyFrom(checkpoint.getField(CheckpointField::VelocityY));
+    diffusedPressure.copyFrom(checkpoint.getField(CheckpointField::DiffusedPressure));
+    advectedPressure.copyFrom(checkpoint.getField(CheckpointField::AdvectedPressure));
+
+    stepCount = header.stepCount;
+    noiseSettings.seed = header.noiseSeed;
+    noiseStep = header.noiseStep;
+}
+
+void FluidSim::loadCheckpoint(const std::string &path)
+{
+    loadCheckpoint(Checkpoint(path));
+}
+
+std::array<Field *, 8> FluidSim::gridFields()
+{
+    return {&density, &velocityX, &velocityY,
+            &prevDensity, &prevVelocityX, &prevVelocityY,
+            &diffusedPressure, &advectedPressure};
+}
+
+void FluidSim::step(float dt)
+{
+    pressureStats = SolverStats();
+    diffusionStats = SolverStats();
+    stats.steps++;
+    stepCount++;
+    if (obstacles.isChanged())
+        updateObstacles();
+    applySplats(dt);
+
+    // Split the step so no substep moves the fluid more than the target
+    // number of cells
+    substepCount = 1;
+    if (timestepSettings.adaptive && timestepSettings.targetCfl > 0.0f)
     {
-        for (int j = 1; j < height - 1; j++)
-        {
-            // Calculate the error between original and round-trip advection
-            float error = source[i][j] - tempField2[i][j];
+        float cfl = maxSpeed(velocityX, velocityY) * dt * width;
+        float needed = std::ceil(cfl / timestepSettings.targetCfl);
+        substepCount = std::max(1, timestepSettings.maxSubsteps);
+        if (needed < substepCount)
+            substepCount = std::max(1, static_cast<int>(needed));
+    }
+    stats.substeps += substepCount;
+
+    // Perform velocity and density steps
+    float substepDt = dt / substepCount;
+    for (int k = 0; k < substepCount; k++)
+    {
+        updateActiveTiles(substepDt);
+        velocityStep(substepDt);
+        densityStep(substepDt);
+    }
+}
 
-            // Apply MacCormack correction: result = forward_advection + 0.5 * error
-            dest[i][j] = tempField1[i][j] + 0.5f * error;
+// Mark the tiles that hold fluid, then grow the marked region by as many
+// tiles as the flow can cross in one substep, plus one so fluid arriving
+// at a tile's edge finds it active
+void FluidSim::updateActiveTiles(float dt)
+{
+    if (!sparseSettings.enabled)
+    {
+        activeTiles.setAll(true);
+        return;
+    }
 
-            // Optional: clamp to prevent overshoots (helps with stability)
-            // Find min/max in the neighborhood for clamping
-            float minVal = source[i][j];
-            float maxVal = source[i][j];
+    const int size = TileMask::TILE_SIZE;
+    int tilesX = activeTiles.getTilesX();
+    int tilesY = activeTiles.getTilesY();
+    tileSpeeds.assign(static_cast<std::size_t>(tilesX) * tilesY, 0.0f);
 
-            for (int di = -1; di <= 1; di++)
+    // Largest velocity component and density per tile; rows of tiles are
+    // independent, and each thread's largest speed feeds the dilation
+    float speed = threadPool->parallelMax(0, tilesX, [&](int tileBegin, int tileEnd)
+    {
+        float bandSpeed = 0.0f;
+        for (int tx = tileBegin; tx < tileEnd; tx++)
+        {
+            float *tileSpeed = &tileSpeeds[static_cast<std::size_t>(tx) * tilesY];
+            for (int ty = 0; ty < tilesY; ty++)
             {
-                for (int dj = -1; dj <= 1; dj++)
+                int jBegin = ty * size;
+                int jEnd = std::min(height, jBegin + size);
+                float tileDensity = 0.0f;
+                for (int i = tx * size; i < std::min(width, (tx + 1) * size); i++)
                 {
-                    int ni = i + di;
-                    int nj = j + dj;
-                    if (ni >= 0 && ni < width && nj >= 0 && nj < height)
-                    {
-                        minVal = std::min(minVal, source[ni][nj]);
-                        maxVal = std::max(maxVal, source[ni][nj]);
-                    }
+                    tileSpeed[ty] = std::max(tileSpeed[ty],
+                                             advectKernels->maxSpeedRow(velocityX.row(i), velocityY.row(i), jBegin, jEnd));
+                    tileDensity = std::max(tileDensity,
+                                           advectKernels->maxSpeedRow(density.row(i), density.row(i), jBegin, jEnd));
                 }
+                activeTiles.set(tx, ty, tileSpeed[ty] > sparseSettings.velocityThreshold ||
+                                            tileDensity > sparseSettings.densityThreshold);
+                bandSpeed = std::max(bandSpeed, tileSpeed[ty]);
             }
+        }
+        return bandSpeed;
+    });
+
+    float reach = std::min(dt * width * speed, static_cast<float>(std::max(width, height)));
+    activeTiles.dilate(1 + static_cast<int>(std::ceil(reach / size)));
+}
 
-            // Clamp the result to prevent overshoots
-            dest[i][j] = std::max(minVal, std::min(maxVal, dest[i][j]));
+// Largest velocity component magnitude over the interior cells
+float FluidSim::maxSpeed(const Field &u, const Field &v)
+{
+    return threadPool->parallelMax(1, width - 1, [&](int rowBegin, int rowEnd)
+    {
+        float result = 0.0f;
+        for (int i = rowBegin; i < rowEnd; i++)
+        {
+            result = std::max(result, advectKernels->maxSpeedRow(u.row(i), v.row(i), 1, height - 1));
         }
+        return result;
+    });
+}
+
+// Grid fields stay in rows under the blocked layouts, padded like PaddedRows
+FieldLayout FluidSim::rowLayout() const
+{
+    return fieldLayout == FieldLayout::Rows ? FieldLayout::Rows : FieldLayout::PaddedRows;
+}
+
+bool FluidSim::blockedLayout() const
+{
+    return fieldLayout == FieldLayout::Tiled || fieldLayout == FieldLayout::Morton;
+}
+
+// Copy field, ghost cells included, into the blocked layout the advectors
+// sample. Each thread writes whole blocks of the layout.
+StorageView FluidSim::sampleCopy(const Field &field, SampleField &copy)
+{
+    if (copy.getWidth() != width || copy.getHeight() != height || copy.getLayout() != fieldLayout)
+    {
+        copy.resize(width, height, fieldLayout);
     }
-    setBoundary(b, dest);
+
+    int blockRows = copy.getBlockRows();
+    const int *columns = copy.getColumnOffsets();
+    float *cells = copy.data();
+    threadPool->parallelFor(0, (width + blockRows - 1) / blockRows, [&](int blockBegin, int blockEnd)
+    {
+        for (int i = blockBegin * blockRows; i < std::min(width, blockEnd * blockRows); i++)
+        {
+            float *dest = cells + copy.rowOffset(i);
+            const float *row = field.row(i);
+            for (int j = 0; j < height; j++)
+            {
+                dest[columns[j]] = row[j];
+            }
+        }
+    });
+    return copy.view();
+}
+
+// Add source terms to the density/velocity fields over the marked tiles
+void FluidSim::addSource(Field &dest, const Field &source, const TileMask &tiles)
+{
+    threadPool->parallelFor(1, width - 1, [&](int rowBegin, int rowEnd)
+    {
+        for (int i = rowBegin; i < rowEnd; i++)
+        {
+            float *destRow = dest.row(i);
+            const float *sourceRow = source.row(i);
+            tiles.forEachSpan(i, 1, height - 1, [&](int jBegin, int jEnd)
+            {
+                for (int j = jBegin; j < jEnd; j++)
+                {
+                    destRow[j] += sourceRow[j];
+                }
+            });
+        }
+    });
+}
+
+int FluidSim::addEmitter(const Splat &rate)
+{
+    emitters.push_back({nextEmitterId, rate});
+    return nextEmitterId++;
 }
 
-// Main advection method - can switch between different advection schemes
-void FluidSim::advect(int b, float dest[GRID_SIZE_X][GRID_SIZE_Y], const float source[GRID_SIZE_X][GRID_SIZE_Y],
-                      const float u[GRID_SIZE_X][GRID_SIZE_Y], const float v[GRID_SIZE_X][GRID_SIZE_Y], float dt)
+void FluidSim::removeEmitter(int id)
 {
-    // Available advection methods (uncomment desired method):
-    //
-    // RK4 - Uses 4th order Runge-Kutta integration for particle tracing
-    //       Highest accuracy, preserves fine details, but computationally expensive
-    rk4Advect(b, dest, source, u, v, dt);
+    emitters.erase(std::remove_if(emitters.begin(), emitters.end(), [id](const Emitter &e) { return e.id == id; }),
+                   emitters.end());
+}
+
+// Rebuild the boundary lists after the obstacle cells changed, and give the
+// fields' solid cells their boundary values
+void FluidSim::updateObstacles()
+{
+    obstacles.updateBoundaryCells();
+    conjugateGradient.setObstacles(&obstacles);
+    setBoundary<0>(density);
+    setBoundary<1>(velocityX);
+    setBoundary<2>(velocityY);
+}
+
+// Rasterize the queued splats and the emitters into the prev fields, which
+// are scratch until the velocity step, over the tiles they reach, then add
+// those tiles into the live fields
+void FluidSim::applySplats(float dt)
+{
+    if (pendingSplats.empty() && emitters.empty())
+        return;
+
+    splatTiles.setAll(false);
+    auto markTiles = [&](const Splat &splat)
+    {
+        SplatBounds bounds = getSplatBounds(splat, width, height);
+        if (bounds.iBegin >= bounds.iEnd || bounds.jBegin >= bounds.jEnd)
+            return;
+        for (int tx = bounds.iBegin / TileMask::TILE_SIZE; tx * TileMask::TILE_SIZE < bounds.iEnd; tx++)
+        {
+            for (int ty = bounds.jBegin / TileMask::TILE_SIZE; ty * TileMask::TILE_SIZE < bounds.jEnd; ty++)
+            {
+                splatTiles.set(tx, ty, true);
+            }
+        }
+    };
+    for (const Splat &splat : pendingSplats)
+        markTiles(splat);
+    for (const Emitter &emitter : emitters)
+        markTiles(emitter.rate);
+
+    threadPool->parallelFor(1, width - 1, [&](int rowBegin, int rowEnd)
+    {
+        for (int i = rowBegin; i < rowEnd; i++)
+        {
+            splatTiles.forEachSpan(i, 1, height - 1, [&](int jBegin, int jEnd)
+            {
+                for (Field *field : {&prevDensity, &prevVelocityX, &prevVelocityY})
+                {
+                    std::fill(field->row(i) + jBegin, field->row(i) + jEnd, 0.0f);
+                }
+            });
+        }
+    });
 
-    // MacCormack - Two-step predictor-corrector method with error correction
-    //              Good balance of accuracy and performance, reduces numerical diffusion
-    // macCormackAdvect(b, dest, source, u, v, dt);
+    for (const Splat &splat : pendingSplats)
+    {
+        rasterizeSplat(splat, 1.0f, getSplatBounds(splat, width, height), splatWeights, prevDensity,
+                       prevVelocityX, prevVelocityY);
+    }
+    for (const Emitter &emitter : emitters)
+    {
+        rasterizeSplat(emitter.rate, dt, getSplatBounds(emitter.rate, width, height), splatWeights, prevDensity,
+                       prevVelocityX, prevVelocityY);
+    }
+    pendingSplats.clear();
 
-    // Semi-Lagrangian - Basic backward particle tracing with bilinear interpolation
-    //                   Fastest but most diffusive, good for real-time applications
-    // semiLagrangianAdvect(b, dest, source, u, v, dt);
+    addSource(density, prevDensity, splatTiles);
+    addSource(velocityX, prevVelocityX, splatTiles);
+    addSource(velocityY, prevVelocityY, splatTiles);
 }
 
-// Helper method for bilinear interpolation
-float FluidSim::bilinearInterpolate(const float field[GRID_SIZE_X][GRID_SIZE_Y], float x, float y) const
+// Diffuse the field using Gauss-Seidel relaxation
+void FluidSim::diffuse(int b, Field &dest, const Field &source, float diff, float dt)
 {
-    // Clamp to grid bounds
-    x = std::max(0.5f, std::min(width - 1.5f, x));
-    y = std::max(0.5f, std::min(height - 1.5f, y));
+    ScopedStage timer(stats, trace, Stage::Diffuse, 0);
 
-    // Find grid cell indices
-    int i0 = static_cast<int>(x);
-    int i1 = i0 + 1;
-    int j0 = static_cast<int>(y);
-    int j1 = j0 + 1;
+    float a = dt * diff * width * height;
+    float cRecip = 1.0f / (1 + 4 * a);
+    float omega = 1.5f; // Relaxation parameter for SOR
 
-    // Bilinear interpolation weights
-    float s1 = x - i0;
-    float s0 = 1 - s1;
-    float t1 = y - j0;
-    float t0 = 1 - t1;
+    // Runs of the active fluid cells of row i; solid cells are skipped, and
+    // setBoundary gives them their values
+    auto forEachSpan = [&](int i, auto fn)
+    {
+        activeTiles.forEachSpan(i, 1, height - 1, [&](int tileBegin, int tileEnd)
+        {
+            obstacles.forEachFluidSpan(i, tileBegin, tileEnd, fn);
+        });
+    };
+
+    // Successive Over-Relaxation in red-black order: a cell of one color only
+    // reads cells of the other, so each half-sweep splits across threads and
+    // gives the same result for any thread count
+    auto sweep = [&]()
+    {
+        for (int color = 0; color < 2; color++)
+        {
+            threadPool->parallelFor(1, width - 1, [&](int rowBegin, int rowEnd)
+            {
+                for (int i = rowBegin; i < rowEnd; i++)
+                {
+                    const float *neighbours[2] = {dest.row(i + 1), dest.row(i - 1)};
+                    forEachSpan(i, [&](int jBegin, int jEnd)
+                    {
+                        advectKernels->sorLine(dest.row(i), source.row(i), neighbours, 2,
+                                               jBegin + ((i + jBegin + color) & 1), jEnd, a, cRecip, omega);
+                    });
+                }
+            });
+        }
+        setBoundary(b, dest);
+    };
 
-    // Bilinear interpolation
-    return s0 * (t0 * field[i0][j0] + t1 * field[i0][j1]) +
-           s1 * (t0 * field[i1][j0] + t1 * field[i1][j1]);
+    // Largest error of (1 + 4a) x - a * (sum of neighbours) = source over the
+    // cells the sweeps update, relative to the largest source value
+    float sourceNorm = -1.0f;
+    auto residual = [&]()
+    {
+        if (sourceNorm < 0.0f)
+        {
+            sourceNorm = threadPool->parallelMax(1, width - 1, [&](int rowBegin, int rowEnd)
+            {
+                float result = 0.0f;
+                for (int i = rowBegin; i < rowEnd; i++)
+                {
+                    forEachSpan(i, [&](int jBegin, int jEnd)
+                    {
+                        for (int j = jBegin; j < jEnd; j++)
+                        {
+                            result = std::max(result, std::fabs(source(i, j)));
+                        }
+                    });
+                }
+                return result;
+            });
+        }
+        float norm = threadPool->parallelMax(1, width - 1, [&](int rowBegin, int rowEnd)
+        {
+            float result = 0.0f;
+            for (int i = rowBegin; i < rowEnd; i++)
+            {
+                forEachSpan(i, [&](int jBegin, int jEnd)
+                {
+                    for (int j = jBegin; j < jEnd; j++)
+                    {
+                        float neighbours = dest(i + 1, j) + dest(i - 1, j) + dest(i, j + 1) + dest(i, j - 1);
+                        result = std::max(result, std::fabs(source(i, j) - ((1 + 4 * a) * dest(i, j) - a * neighbours)));
+                    }
+                });
+            }
+            return result;
+        });
+        return relativeResidual(norm, sourceNorm);
+    };
+
+    SolverStats solve = relax(diffusionSettings, sweep, residual);
+    timer.addCells(static_cast<long long>(solve.iterations) * (width - 2) * (height - 2));
+    diffusionStats.iterations += solve.iterations;
+    diffusionStats.residual = std::max(diffusionStats.residual, solve.residual);
+    stats.diffusionSolves++;
+    stats.diffusionIterations += solve.iterations;
+    stats.worstDiffusionResidual = std::max(stats.worstDiffusionResidual, solve.residual);
 }
 
-// Helper method to get velocity at arbitrary position
-glm::vec2 FluidSim::getVelocityAt(const float u[GRID_SIZE_X][GRID_SIZE_Y], const float v[GRID_SIZE_X][GRID_SIZE_Y], float x, float y) const
+// Semi-Lagrangian advection (original method)
+template <int B>
+void FluidSim::semiLagrangianAdvect(Field &dest, const Field &source,
+                                    const Field &u, const Field &v, const AdvectSamples &samples, float dt)
 {
-    return glm::vec2(bilinearInterpolate(u, x, y), bilinearInterpolate(v, x, y));
+    float dt0 = dt * width;
+
+    threadPool->parallelFor(1, width - 1, [&](int rowBegin, int rowEnd)
+    {
+        for (int i = rowBegin; i < rowEnd; i++)
+        {
+            // Trace particle positions backward and interpolate bilinearly
+            activeTiles.forEachSpan(i, 1, height - 1, [&](int jBegin, int jEnd)
+            {
+                if (samples.copied)
+                    advectKernels->traceRowStored(dest.row(i), samples.source, samples.u, samples.v, i, jBegin, jEnd, -dt0);
+                else
+                    advectKernels->traceRow(dest.row(i), source.view(), u.row(i), v.row(i), i, jBegin, jEnd, -dt0);
+            });
+        }
+    });
+    setBoundary<B>(dest);
 }
 
-// RK4 advection method - highest accuracy, uses 4th order Runge-Kutta integration
-void FluidSim::rk4Advect(int b, float dest[GRID_SIZE_X][GRID_SIZE_Y], const float source[GRID_SIZE_X][GRID_SIZE_Y],
-                         const float u[GRID_SIZE_X][GRID_SIZE_Y], const float v[GRID_SIZE_X][GRID_SIZE_Y], float dt)
+// MacCormack advection method - more accurate, reduces numerical diffusion.
+//
+// The predictor, corrector and limiter run fused over tiles of rows sized to
+// stay in L2, so source, u and v stream from memory once. Each thread keeps
+// a sliding window of predictor rows covering its tile plus a halo as deep as
+// the forward trace can reach; rows shared by consecutive tiles are kept, so
+// only the halos at the ends of a band are predicted twice.
+template <int B>
+void FluidSim::macCormackAdvect(Field &dest, const Field &source,
+                                const Field &u, const Field &v, const AdvectSamples &samples, float dt)
 {
     float dt0 = dt * width;
 
-    for (int i = 1; i < width - 1; i++)
+    // The corrector traces at most dt0 * max|u| rows away from its own row,
+    // and bilinear sampling reaches one row further
+    float speed = maxSpeed(u, v);
+    int halo = width;
+    if (dt0 * speed < width)
+    {
+        halo = static_cast<int>(std::ceil(dt0 * speed)) + 1;
+    }
+
+    // A tile touches one row each of the predictor, source, u, v and dest
+    std::size_t rowBytes = static_cast<std::size_t>(source.getStride()) * sizeof(float);
+    int tileRows = std::max(4, static_cast<int>(MACCORMACK_TILE_BYTES / (5 * rowBytes)));
+
+    threadPool->parallelForBands(1, width - 1, [&](int band, int bandBegin, int bandEnd)
     {
-        for (int j = 1; j < height - 1; j++)
+        // Predictor rows [windowBegin, windowEnd), plus a last row holding
+        // the corrector's output for the current row
+        Field &window = macCormackWindows[band];
+        int windowRows = std::min(width, tileRows + 2 * halo) + 1;
+        if (window.getWidth() < windowRows || window.getHeight() != height || window.getLayout() != source.getLayout())
         {
-            float x = static_cast<float>(i);
-            float y = static_cast<float>(j);
+            window.resize(windowRows, height, source.getLayout());
+        }
+        float *corrected = window.row(window.getWidth() - 1);
+        int windowBegin = 0, windowEnd = 0;
+
+        for (int tileBegin = bandBegin; tileBegin < bandEnd; tileBegin += tileRows)
+        {
+            int tileEnd = std::min(tileBegin + tileRows, bandEnd);
+            int needBegin = std::max(0, tileBegin - halo);
+            int needEnd = std::min(width, tileEnd + halo);
+
+            // Slide the window, keeping rows the previous tile predicted
+            int first = needBegin;
+            if (needBegin < windowEnd)
+            {
+                std::memmove(window.row(0), window.row(needBegin - windowBegin), (windowEnd - needBegin) * rowBytes);
+                first = windowEnd;
+            }
+            windowBegin = needBegin;
+            windowEnd = needEnd;
+
+            // Step 1: Forward advection (predictor step)
+            // Semi-Lagrangian trace backward, with the ghost cells the
+            // corrector samples set as applyBoundary would. Inactive tiles
+            // hold still fluid, whose prediction is the source itself.
+            for (int r = std::max(first, 1); r < std::min(needEnd, width - 1); r++)
+            {
+                float *row = window.row(r - windowBegin);
+                int j = 1;
+                activeTiles.forEachSpan(r, 1, height - 1, [&](int jBegin, int jEnd)
+                {
+                    std::memcpy(row + j, source.row(r) + j, (jBegin - j) * sizeof(float));
+                    if (samples.copied)
+                        advectKernels->traceRowStored(row, samples.source, samples.u, samples.v, r, jBegin, jEnd, -dt0);
+                    else
+                        advectKernels->traceRow(row, source.view(), u.row(r), v.row(r), r, jBegin, jEnd, -dt0);
+                    j = jEnd;
+                });
+                std::memcpy(row + j, source.row(r) + j, (height - 1 - j) * sizeof(float));
+                fillGhostColumns<B>(row, height);
+            }
+            if (first == 0)
+            {
+                fillGhostRow<B>(window.row(0), window.row(1), height);
+            }
+            if (first < width && needEnd == width)
+            {
+                fillGhostRow<B>(window.row(width - 1 - windowBegin), window.row(width - 2 - windowBegin), height);
+            }
 
-            // RK4 integration to find particle's original position
-            // k1: initial velocity at current position
-            glm::vec2 k1 = getVelocityAt(u, v, x, y) * (-dt0);
+            FieldView predicted = {window.data(), width, height, window.getStride(), windowBegin};
+            for (int i = tileBegin; i < tileEnd; i++)
+            {
+                const float *forward = window.row(i - windowBegin);
+                const float *previous = source.row(i - 1);
+                const float *current = source.row(i);
+                const float *next = source.row(i + 1);
+                float *result = dest.row(i);
 
-            // k2: velocity at midpoint using k1
-            glm::vec2 pos2 = glm::vec2(x, y) + k1 * 0.5f;
-            glm::vec2 k2 = getVelocityAt(u, v, pos2.x, pos2.y) * (-dt0);
+                activeTiles.forEachSpan(i, 1, height - 1, [&](int jBegin, int jEnd)
+                {
+                    // Step 2: Backward advection (corrector step)
+                    // Advect the prediction backward in time by tracing
+                    // particle positions forward (opposite direction)
+                    if (samples.copied)
+                        advectKernels->traceRowStored(corrected, storageView(predicted), samples.u, samples.v, i, jBegin, jEnd, dt0);
+                    else
+                        advectKernels->traceRow(corrected, predicted, u.row(i), v.row(i), i, jBegin, jEnd, dt0);
+
+                    // Step 3: Apply half the round-trip error as a correction
+                    // and clamp to the source neighbourhood to prevent
+                    // overshoots. Interior cells have all eight neighbours,
+                    // so no bounds checks.
+                    for (int j = jBegin; j < jEnd; j++)
+                    {
+                        float value = forward[j] + 0.5f * (current[j] - corrected[j]);
+
+                        float minVal = std::min({previous[j - 1], previous[j], previous[j + 1],
+                                                 current[j - 1], current[j], current[j + 1],
+                                                 next[j - 1], next[j], next[j + 1]});
+                        float maxVal = std::max({previous[j - 1], previous[j], previous[j + 1],
+                                                 current[j - 1], current[j], current[j + 1],
+                                                 next[j - 1], next[j], next[j + 1]});
+                        result[j] = std::max(minVal, std::min(maxVal, value));
+                    }
+                });
+            }
+        }
+    });
+    setBoundary<B>(dest);
+}
 
-            // k3: velocity at midpoint using k2
-            glm::vec2 pos3 = glm::vec2(x, y) + k2 * 0.5f;
-            glm::vec2 k3 = getVelocityAt(u, v, pos3.x, pos3.y) * (-dt0);
+const FluidSim::AdvectMethod FluidSim::ADVECT_METHODS[3][3] = {
+    // Basic backward particle tracing with bilinear interpolation
+    // Fastest but most diffusive, good for real-time applications
+    {&FluidSim::semiLagrangianAdvect<0>, &FluidSim::semiLagrangianAdvect<1>, &FluidSim::semiLagrangianAdvect<2>},
+    // Two-step predictor-corrector method with error correction
+    // Good balance of accuracy and performance, reduces numerical diffusion
+    {&FluidSim::macCormackAdvect<0>, &FluidSim::macCormackAdvect<1>, &FluidSim::macCormackAdvect<2>},
+    // Uses 4th order Runge-Kutta integration for particle tracing
+    // Highest accuracy, preserves fine details, but computationally expensive
+    {&FluidSim::rk4Advect<0>, &FluidSim::rk4Advect<1>, &FluidSim::rk4Advect<2>},
+};
+
+// Main advection method - selects the scheme once per field, so the cell
+// loops carry no branches on the scheme or the boundary type
+void FluidSim::advect(AdvectionScheme scheme, int b, Field &dest, const Field &source,
+                      const Field &u, const Field &v, const AdvectSamples &samples, float dt)
+{
+    ScopedStage timer(stats, trace, Stage::Advect, static_cast<long long>(width - 2) * (height - 2));
 
-            // k4: velocity at endpoint using k3
-            glm::vec2 pos4 = glm::vec2(x, y) + k3;
-            glm::vec2 k4 = getVelocityAt(u, v, pos4.x, pos4.y) * (-dt0);
+    (this->*ADVECT_METHODS[static_cast<int>(scheme)][b])(dest, source, u, v, samples, dt);
+}
 
-            // RK4 weighted average
-            glm::vec2 displacement = (k1 + 2.0f * k2 + 2.0f * k3 + k4) / 6.0f;
-            glm::vec2 sourcePos = glm::vec2(x, y) + displacement;
+// RK4 advection method - highest accuracy, uses 4th order Runge-Kutta integration
+template <int B>
+void FluidSim::rk4Advect(Field &dest, const Field &source,
+                         const Field &u, const Field &v, const AdvectSamples &samples, float dt)
+{
+    float dt0 = dt * width;
 
-            // Interpolate the value at the source position
-            dest[i][j] = bilinearInterpolate(source, sourcePos.x, sourcePos.y);
+    threadPool->parallelFor(1, width - 1, [&](int rowBegin, int rowEnd)
+    {
+        for (int i = rowBegin; i < rowEnd; i++)
+        {
+            // RK4 integration to find each particle's original position, then
+            // interpolate the value at that position
+            activeTiles.forEachSpan(i, 1, height - 1, [&](int jBegin, int jEnd)
+            {
+                if (samples.copied)
+                    advectKernels->rk4RowStored(dest.row(i), samples.source, samples.u, samples.v, i, jBegin, jEnd, dt0);
+                else
+                    advectKernels->rk4Row(dest.row(i), source.view(), u.view(), v.view(), i, jBegin, jEnd, dt0);
+            });
         }
-    }
-    setBoundary(b, dest);
+    });
+    setBoundary<B>(dest);
 }
 
 // Project velocity field to be mass-conserving (divergence-free)
-void FluidSim::project(float u[GRID_SIZE_X][GRID_SIZE_Y], float v[GRID_SIZE_X][GRID_SIZE_Y],
-                       float p[GRID_SIZE_X][GRID_SIZE_Y], float div[GRID_SIZE_X][GRID_SIZE_Y])
+void FluidSim::project(Field &u, Field &v,
+                       Field &p, Field &div)
 {
+    ScopedStage timer(stats, trace, Stage::Project, static_cast<long long>(width - 2) * (height - 2));
+
     float h = 1.0f / width;
 
-    // Calculate divergence
-    for (int i = 1; i < width - 1; i++)
+    // Calculate divergence, and start the pressure from zero unless it is
+    // warm-started from the last solve
+    bool coldStart = !pressureWarmStart;
+    threadPool->parallelFor(1, width - 1, [&](int rowBegin, int rowEnd)
     {
-        for (int j = 1; j < height - 1; j++)
+        for (int i = rowBegin; i < rowEnd; i++)
         {
-            div[i][j] = -0.5f * h * (u[i + 1][j] - u[i - 1][j] + v[i][j + 1] - v[i][j - 1]);
-            p[i][j] = 0;
+            for (int j = 1; j < height - 1; j++)
+            {
+                div(i, j) = -0.5f * h * (u(i + 1, j) - u(i - 1, j) + v(i, j + 1) - v(i, j - 1));
+                if (coldStart)
+                    p(i, j) = 0;
+            }
         }
-    }
+    });
     setBoundary(0, div);
     setBoundary(0, p);
 
-    // Solve Poisson equation
-    for (int k = 0; k < 20; k++)
+    // Solve Poisson equation. Multigrid's coarse levels have no obstacles,
+    // so the conjugate gradient solver, which does, stands in while there
+    // are any.
+    PressureSolver solver = pressureSolver;
+    if (solver == PressureSolver::Multigrid && !obstacles.empty())
+        solver = PressureSolver::ConjugateGradient;
+
+    SolverStats solve;
+    switch (solver)
+    {
+    case PressureSolver::GaussSeidel:
     {
-        for (int i = 1; i < width - 1; i++)
+        // Red-black ordered so each half-sweep can run in parallel
+        auto sweep = [&]()
         {
-            for (int j = 1; j < height - 1; j++)
+            for (int color = 0; color < 2; color++)
             {
-                p[i][j] = (div[i][j] + p[i + 1][j] + p[i - 1][j] +
-                           p[i][j + 1] + p[i][j - 1]) /
-                          4;
+                threadPool->parallelFor(1, width - 1, [&](int rowBegin, int rowEnd)
+                {
+                    for (int i = rowBegin; i < rowEnd; i++)
+                    {
+                        const float *neighbours[2] = {p.row(i + 1), p.row(i - 1)};
+                        obstacles.forEachFluidSpan(i, 1, height - 1, [&](int jBegin, int jEnd)
+                        {
+                            advectKernels->gaussSeidelLine(p.row(i), div.row(i), neighbours, 2,
+                                                           jBegin + ((i + jBegin + color) & 1), jEnd, 4.0f);
+                        });
+                    }
+                });
             }
-        }
-        setBoundary(0, p);
+            setBoundary(0, p);
+        };
+
+        // Largest error of 4 p - (sum of neighbours) = div over the fluid
+        // cells, relative to the largest divergence
+        float divNorm = -1.0f;
+        auto residual = [&]()
+        {
+            auto maxOverFluid = [&](auto cellValue)
+            {
+                return threadPool->parallelMax(1, width - 1, [&](int rowBegin, int rowEnd)
+                {
+                    float result = 0.0f;
+                    for (int i = rowBegin; i < rowEnd; i++)
+                    {
+                        obstacles.forEachFluidSpan(i, 1, height - 1, [&](int jBegin, int jEnd)
+                        {
+                            for (int j = jBegin; j < jEnd; j++)
+                            {
+                                result = std::max(result, std::fabs(cellValue(i, j)));
+                            }
+                        });
+                    }
+                    return result;
+                });
+            };
+            if (divNorm < 0.0f)
+                divNorm = maxOverFluid([&](int i, int j) { return div(i, j); });
+            float norm = maxOverFluid([&](int i, int j)
+            {
+                return div(i, j) - (4 * p(i, j) - p(i + 1, j) - p(i - 1, j) - p(i, j + 1) - p(i, j - 1));
+            });
+            return relativeResidual(norm, divNorm);
+        };
+
+        solve = relax(gaussSeidelSettings, sweep, residual);
+        break;
     }
+    case PressureSolver::Multigrid:
+    {
+        // A warm start keeps the pressure as the first guess, which the FMG
+        // pass would replace
+        MultigridSettings settings = multigridSettings;
+        settings.fullMultigrid = settings.fullMultigrid && !pressureWarmStart;
+        solve = multigrid.solve(p, div, settings);
+        break;
+    }
+    case PressureSolver::ConjugateGradient:
+        solve = conjugateGradient.solve(p, div, pcgSettings);
+        if (!obstacles.empty())
+            setBoundary(0, p);
+        break;
+    }
+    pressureStats.iterations += solve.iterations;
+    pressureStats.residual = std::max(pressureStats.residual, solve.residual);
+    stats.pressureSolves++;
+    stats.pressureIterations += solve.iterations;
+    stats.worstPressureResidual = std::max(stats.worstPressureResidual, solve.residual);
 
     // Apply pressure gradient to velocity
-    for (int i = 1; i < width - 1; i++)
+    threadPool->parallelFor(1, width - 1, [&](int rowBegin, int rowEnd)
     {
-        for (int j = 1; j < height - 1; j++)
+        for (int i = rowBegin; i < rowEnd; i++)
         {
-            u[i][j] -= 0.5f * (p[i + 1][j] - p[i - 1][j]) / h;
-            v[i][j] -= 0.5f * (p[i][j + 1] - p[i][j - 1]) / h;
+            for (int j = 1; j < height - 1; j++)
+            {
+                u(i, j) -= 0.5f * (p(i + 1, j) - p(i - 1, j)) / h;
+                v(i, j) -= 0.5f * (p(i, j + 1) - p(i, j - 1)) / h;
+            }
         }
-    }
+    });
     setBoundary(1, u);
     setBoundary(2, v);
 }
 
-// Set boundary conditions
-void FluidSim::setBoundary(int b, float x[GRID_SIZE_X][GRID_SIZE_Y])
+// Set boundary conditions: solid cells first, from the fluid around them,
+// then the walls, which may copy cells next to them that are solid
+void FluidSim::setBoundary(int b, Field &x)
 {
-    // Walls
-    for (int i = 1; i < width - 1; i++)
-    {
-        x[i][0] = b == 2 ? -x[i][1] : x[i][1];
-        x[i][height - 1] = b == 2 ? -x[i][height - 2] : x[i][height - 2];
-    }
+    ScopedStage timer(stats, trace, Stage::Boundary, 2LL * (width + height) - 4);
+    if (!obstacles.empty())
+        obstacles.apply(b, x);
+    applyBoundary(b, x);
+}
 
-    for (int j = 1; j < height - 1; j++)
+template <int B>
+void FluidSim::setBoundary(Field &x)
+{
+    ScopedStage timer(stats, trace, Stage::Boundary, 2LL * (width + height) - 4);
+    if (!obstacles.empty())
+        obstacles.apply<B>(x);
+    applyBoundary<B>(x);
+}
+
+// Add minute random noise to the velocity field, one sample per block of
+// cells, keyed on (seed, step, block) so any thread can generate any part
+void FluidSim::addNoise()
+{
+    std::uint32_t key = noiseKey(noiseSettings.seed, noiseStep++);
+    if (!noiseSettings.enabled)
+        return;
+
+    int block = std::max(1, noiseSettings.blockSize);
+    std::uint32_t blocksY = static_cast<std::uint32_t>((height + block - 1) / block);
+    float amplitude = noiseSettings.amplitude;
+
+    threadPool->parallelFor(0, width, [&](int rowBegin, int rowEnd)
     {
-        x[0][j] = b == 1 ? -x[1][j] : x[1][j];
-        x[width - 1][j] = b == 1 ? -x[width - 2][j] : x[width - 2][j];
-    }
+        for (int i = rowBegin; i < rowEnd; i++)
+        {
+            float *u = velocityX.row(i);
+            float *v = velocityY.row(i);
+            std::uint32_t rowBase = static_cast<std::uint32_t>(i / block) * blocksY;
+
+            if (block == 1)
+            {
+                for (int j = 0; j < height; j++)
+                {
+                    std::uint32_t sample = 2 * (rowBase + j);
+                    u[j] += hashNoise(key, sample) * amplitude;
+                    v[j] += hashNoise(key, sample + 1) * amplitude;
+                }
+                continue;
+            }
 
-    // Corners
-    x[0][0] = 0.5f * (x[1][0] + x[0][1]);
-    x[0][height - 1] = 0.5f * (x[1][height - 1] + x[0][height - 2]);
-    x[width - 1][0] = 0.5f * (x[width - 2][0] + x[width - 1][1]);
-    x[width - 1][height - 1] = 0.5f * (x[width - 2][height - 1] + x[width - 1][height - 2]);
+            for (std::uint32_t bj = 0; bj < blocksY; bj++)
+            {
+                std::uint32_t sample = 2 * (rowBase + bj);
+                float noiseX = hashNoise(key, sample) * amplitude;
+                float noiseY = hashNoise(key, sample + 1) * amplitude;
+                int jEnd = std::min(height, static_cast<int>(bj + 1) * block);
+                for (int j = static_cast<int>(bj) * block; j < jEnd; j++)
+                {
+                    u[j] += noiseX;
+                    v[j] += noiseY;
+                }
+            }
+        }
+    });
 }
 
 // Update velocity field
 void FluidSim::velocityStep(float dt)
 {
+    ScopedStage timer(stats, trace, Stage::VelocityStep, static_cast<long long>(width) * height);
 
-    // Add minute random noise to velocity field
-    for (int i = 0; i < width; ++i)
-    {
-        for (int j = 0; j < height; ++j)
-        {
-            float noiseX = ((float)rand() / RAND_MAX - 0.5f) * 1e-4f;
-            float noiseY = ((float)rand() / RAND_MAX - 0.5f) * 1e-4f;
-            velocityX[i][j] += noiseX;
-            velocityY[i][j] += noiseY;
-        }
-    }
+    addNoise();
 
     // Save previous state
-    std::copy(&velocityX[0][0], &velocityX[0][0] + GRID_SIZE_X * GRID_SIZE_Y, &prevVelocityX[0][0]);
-    std::copy(&velocityY[0][0], &velocityY[0][0] + GRID_SIZE_X * GRID_SIZE_Y, &prevVelocityY[0][0]);
+    prevVelocityX.copyFrom(velocityX);
+    prevVelocityY.copyFrom(velocityY);
 
     // Diffuse velocity
-    diffuse(1, velocityX, prevVelocityX, VISCOSITY, dt);
-    diffuse(2, velocityY, prevVelocityY, VISCOSITY, dt);
+    diffuse(1, velocityX, prevVelocityX, viscosity, dt);
+    diffuse(2, velocityY, prevVelocityY, viscosity, dt);
 
     // Project to ensure mass conservation
-    project(velocityX, velocityY, prevVelocityX, prevVelocityY);
-
-    // Save state before advection
-    std::copy(&velocityX[0][0], &velocityX[0][0] + GRID_SIZE_X * GRID_SIZE_Y, &prevVelocityX[0][0]);
-    std::copy(&velocityY[0][0], &velocityY[0][0] + GRID_SIZE_X * GRID_SIZE_Y, &prevVelocityY[0][0]);
+    project(velocityX, velocityY, diffusedPressure, prevVelocityY);
+
+    // Save state before advection. Under the blocked layouts the advectors
+    // gather from blocked copies instead. RK4 gathers its velocity too, so
+    // it samples everything from the copies, made straight from the current
+    // fields, and the save is skipped; the other schemes read velocity
+    // along rows and gather only from copies of the advected component.
+    bool rk4 = velocityScheme == AdvectionScheme::RK4;
+    bool copyVelocity = blockedLayout() && rk4;
+    AdvectSamples samples = {storageView(prevVelocityX.view()), storageView(prevVelocityX.view()),
+                             storageView(prevVelocityY.view()), false};
+    if (copyVelocity)
+    {
+        samples.u = sampleCopy(velocityX, velocitySamplesX);
+        samples.v = sampleCopy(velocityY, velocitySamplesY);
+        samples.copied = true;
+    }
+    else
+    {
+        prevVelocityX.copyFrom(velocityX);
+        prevVelocityY.copyFrom(velocityY);
+    }
+    StorageView sourceX = samples.u, sourceY = samples.v;
+    if (blockedLayout() && !rk4)
+    {
+        sourceX = sampleCopy(velocityX, velocitySourcesX);
+        sourceY = sampleCopy(velocityY, velocitySourcesY);
+        samples.copied = true;
+    }
 
     // Advect velocity field
-    advect(1, velocityX, prevVelocityX, prevVelocityX, prevVelocityY, dt);
-    advect(2, velocityY, prevVelocityY, prevVelocityX, prevVelocityY, dt);
+    samples.source = sourceX;
+    advect(velocityScheme, 1, velocityX, prevVelocityX, prevVelocityX, prevVelocityY, samples, dt);
+    samples.source = sourceY;
+    advect(velocityScheme, 2, velocityY, prevVelocityY, prevVelocityX, prevVelocityY, samples, dt);
 
     // Project again
-    project(velocityX, velocityY, prevVelocityX, prevVelocityY);
+    project(velocityX, velocityY, advectedPressure, prevVelocityY);
 }
 
 // Update density field
 void FluidSim::densityStep(float dt)
 {
+    ScopedStage timer(stats, trace, Stage::DensityStep, static_cast<long long>(width) * height);
+
     // Save previous state
-    std::copy(&density[0][0], &density[0][0] + GRID_SIZE_X * GRID_SIZE_Y, &prevDensity[0][0]);
+    prevDensity.copyFrom(density);
 
     // Diffuse density
-    diffuse(0, density, prevDensity, DIFFUSION, dt);
-
-    // Save state before advection
-    std::copy(&density[0][0], &density[0][0] + GRID_SIZE_X * GRID_SIZE_Y, &prevDensity[0][0]);
+    diffuse(0, density, prevDensity, diffusion, dt);
+
+    // Save state before advection, or make the blocked copies instead as
+    // the velocity step does. The copies replace the save except for
+    // MacCormack, whose limiter reads the source along rows.
+    bool rk4 = densityScheme == AdvectionScheme::RK4;
+    AdvectSamples samples = {storageView(prevDensity.view()), storageView(velocityX.view()),
+                             storageView(velocityY.view()), false};
+    if (!blockedLayout() || densityScheme == AdvectionScheme::MacCormack)
+    {
+        prevDensity.copyFrom(density);
+    }
+    if (blockedLayout())
+    {
+        samples.source = sampleCopy(density, densitySamples);
+        samples.copied = true;
+    }
+    if (blockedLayout() && rk4)
+    {
+        samples.u = sampleCopy(velocityX, velocitySamplesX);
+        samples.v = sampleCopy(velocityY, velocitySamplesY);
+        samples.copied = true;
+    }
 
     // Advect density field
-    advect(0, density, prevDensity, velocityX, velocityY, dt);
+    advect(densityScheme, 0, density, prevDensity, velocityX, velocityY, samples, dt);
 }
 
 void FluidSim::addDensity(int x, int y, float amount)
 {
     if (x >= 0 && x < width && y >= 0 && y < height)
     {
-        density[x][y] += amount;
+        density(x, y) += amount;
     }
 }
 
@@ -433,8 +1070,8 @@ void FluidSim::addVelocity(int x, int y, float amountX, float amountY)
 {
     if (x >= 0 && x < width && y >= 0 && y < height)
     {
-        velocityX[x][y] += amountX;
-        velocityY[x][y] += amountY;
+        velocityX(x, y) += amountX;
+        velocityY(x, y) += amountY;
     }
 }
 
@@ -442,7 +1079,7 @@ float FluidSim::getDensity(int x, int y) const
 {
     if (x >= 0 && x < width && y >= 0 && y < height)
     {
-        return density[x][y];
+        return density(x, y);
     }
     return 0.0f;
 }
@@ -451,7 +1088,7 @@ glm::vec2 FluidSim::getVelocity(int x, int y) const
 {
     if (x >= 0 && x < width && y >= 0 && y < height)
     {
-        return glm::vec2(velocityX[x][y], velocityY[x][y]);
+        return glm::vec2(velocityX(x, y), velocityY(x, y));
     }
     return glm::vec2(0.0f);
 }
@@ -460,7 +1097,7 @@ glm::vec2 FluidSim::getNormalizedVelocity(int x, int y) const
 {
     if (x >= 0 && x < width && y >= 0 && y < height)
     {
-        glm::vec2 vel = glm::vec2(velocityX[x][y], velocityY[x][y]);
+        glm::vec2 vel = glm::vec2(velocityX(x, y), velocityY(x, y));
         float magnitude = glm::length(vel);
         if (magnitude > 0.001f) // Avoid division by zero
         {
@@ -474,7 +1111,7 @@ float FluidSim::getVelocityMagnitude(int x, int y) const
 {
     if (x >= 0 && x < width && y >= 0 && y < height)
     {
-        return glm::length(glm::vec2(velocityX[x][y], velocityY[x][y]));
+        return glm::length(glm::vec2(velocityX(x, y), velocityY(x, y)));
     }
     return 0.0f;
 }
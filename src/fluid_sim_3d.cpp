@@ -0,0 +1,355 @@
+#include "fluid_sim_3d.h"
+#include <algorithm>
+#include <stdexcept>
+
+FluidSim3D::FluidSim3D(int width, int height, int depth, int threadCount)
+{
+    setThreadCount(threadCount);
+    resize(width, height, depth);
+}
+
+void FluidSim3D::setSimdLevel(SimdLevel level)
+{
+    advectKernels = &getAdvectKernels(level);
+}
+
+void FluidSim3D::setAdvectionScheme(AdvectionScheme scheme)
+{
+    velocityScheme = scheme;
+    densityScheme = scheme;
+}
+
+void FluidSim3D::setAdvectionScheme(AdvectedField field, AdvectionScheme scheme)
+{
+    (field == AdvectedField::Velocity ? velocityScheme : densityScheme) = scheme;
+}
+
+AdvectionScheme FluidSim3D::getAdvectionScheme(AdvectedField field) const
+{
+    return field == AdvectedField::Velocity ? velocityScheme : densityScheme;
+}
+
+void FluidSim3D::setThreadCount(int threadCount)
+{
+    threadPool = std::make_unique<ThreadPool>(threadCount);
+    correctedLines.assign(threadPool->getThreadCount(), std::vector<float>(depth));
+}
+
+int FluidSim3D::getThreadCount() const
+{
+    return threadPool->getThreadCount();
+}
+
+void FluidSim3D::resize(int newWidth, int newHeight, int newDepth)
+{
+    if (newWidth < 3 || newHeight < 3 || newDepth < 3)
+    {
+        throw std::invalid_argument("FluidSim3D grid must be at least 3x3x3 cells");
+    }
+
+    width = newWidth;
+    height = newHeight;
+    depth = newDepth;
+
+    // Fields are allocated zero-initialized
+    for (VolumeField *field : gridFields())
+    {
+        field->resize(width, height, depth);
+    }
+    for (std::vector<float> &line : correctedLines)
+    {
+        line.resize(depth);
+    }
+    stepCount = 0;
+}
+
+void FluidSim3D::reset()
+{
+    stepCount = 0;
+
+    // Clear the grid in place, keeping the current allocation
+    for (VolumeField *field : gridFields())
+    {
+        field->fill(0.0f);
+    }
+}
+
+std::vector<VolumeField *> FluidSim3D::gridFields()
+{
+    return {&density, &velocityX, &velocityY, &velocityZ,
+            &prevDensity, &prevVelocityX, &prevVelocityY, &prevVelocityZ, &predicted};
+}
+
+void FluidSim3D::step(float dt)
+{
+    stepCount++;
+    velocityStep(dt);
+    densityStep(dt);
+}
+
+// Red-black SOR as in FluidSim::diffuse, with six neighbours per cell. The
+// color of (i, j, k) is the parity of i + j + k, so every half-sweep only
+// reads cells of the other color and splits across x slabs.
+void FluidSim3D::diffuse(int b, VolumeField &dest, const VolumeField &source, float diff, float dt)
+{
+    float a = dt * diff * width * height;
+    float cRecip = 1.0f / (1 + 6 * a);
+    float omega = 1.5f; // Relaxation parameter for SOR
+
+    for (int sweep = 0; sweep < 5; sweep++)
+    {
+        for (int color = 0; color < 2; color++)
+        {
+            threadPool->parallelFor(1, width - 1, [&](int sliceBegin, int sliceEnd)
+            {
+                for (int i = sliceBegin; i < sliceEnd; i++)
+                {
+                    for (int j = 1; j < height - 1; j++)
+                    {
+                        const float *neighbours[4] = {dest.line(i + 1, j), dest.line(i - 1, j), dest.line(i, j + 1),
+                                                      dest.line(i, j - 1)};
+                        advectKernels->sorLine(dest.line(i, j), source.line(i, j), neighbours, 4,
+                                               1 + ((i + j + 1 + color) & 1), depth - 1, a, cRecip, omega);
+                    }
+                }
+            });
+        }
+        applyBoundary(b, dest);
+    }
+}
+
+void FluidSim3D::advect(AdvectionScheme scheme, int b, VolumeField &dest, const VolumeField &source,
+                        const VolumeField &u, const VolumeField &v, const VolumeField &w, float dt)
+{
+    float dt0 = dt * width;
+    switch (scheme)
+    {
+    case AdvectionScheme::SemiLagrangian:
+        semiLagrangianAdvect(dest, source, u, v, w, dt0);
+        break;
+    case AdvectionScheme::MacCormack:
+        macCormackAdvect(b, dest, source, u, v, w, dt0);
+        break;
+    case AdvectionScheme::RK4:
+        rk4Advect(dest, source, u, v, w, dt0);
+        break;
+    }
+    applyBoundary(b, dest);
+}
+
+void FluidSim3D::semiLagrangianAdvect(VolumeField &dest, const VolumeField &source, const VolumeField &u,
+                                      const VolumeField &v, const VolumeField &w, float dt0)
+{
+    threadPool->parallelFor(1, width - 1, [&](int sliceBegin, int sliceEnd)
+    {
+        for (int i = sliceBegin; i < sliceEnd; i++)
+        {
+            for (int j = 1; j < height - 1; j++)
+            {
+                advectKernels->traceLine(dest.line(i, j), source.view(), u.line(i, j), v.line(i, j), w.line(i, j),
+                                         i, j, 1, depth - 1, -dt0);
+            }
+        }
+    });
+}
+
+// Predict with a backward trace into a scratch volume, trace the prediction
+// forward again line by line and correct by half the round-trip error,
+// clamped to the 27 source cells around each cell
+void FluidSim3D::macCormackAdvect(int b, VolumeField &dest, const VolumeField &source, const VolumeField &u,
+                                  const VolumeField &v, const VolumeField &w, float dt0)
+{
+    semiLagrangianAdvect(predicted, source, u, v, w, dt0);
+    applyBoundary(b, predicted);
+
+    threadPool->parallelForBands(1, width - 1, [&](int band, int sliceBegin, int sliceEnd)
+    {
+        float *corrected = correctedLines[band].data();
+        for (int i = sliceBegin; i < sliceEnd; i++)
+        {
+            for (int j = 1; j < height - 1; j++)
+            {
+                advectKernels->traceLine(corrected, predicted.view(), u.line(i, j), v.line(i, j), w.line(i, j),
+                                         i, j, 1, depth - 1, dt0);
+
+                const float *forward = predicted.line(i, j);
+                const float *current = source.line(i, j);
+                const float *neighbours[9];
+                for (int n = 0; n < 9; n++)
+                {
+                    neighbours[n] = source.line(i + n / 3 - 1, j + n % 3 - 1);
+                }
+
+                float *result = dest.line(i, j);
+                for (int k = 1; k < depth - 1; k++)
+                {
+                    float value = forward[k] + 0.5f * (current[k] - corrected[k]);
+
+                    float minVal = neighbours[0][k];
+                    float maxVal = neighbours[0][k];
+                    for (const float *line : neighbours)
+                    {
+                        minVal = std::min({minVal, line[k - 1], line[k], line[k + 1]});
+                        maxVal = std::max({maxVal, line[k - 1], line[k], line[k + 1]});
+                    }
+                    result[k] = std::max(minVal, std::min(maxVal, value));
+                }
+            }
+        }
+    });
+}
+
+void FluidSim3D::rk4Advect(VolumeField &dest, const VolumeField &source, const VolumeField &u,
+                           const VolumeField &v, const VolumeField &w, float dt0)
+{
+    threadPool->parallelFor(1, width - 1, [&](int sliceBegin, int sliceEnd)
+    {
+        for (int i = sliceBegin; i < sliceEnd; i++)
+        {
+            for (int j = 1; j < height - 1; j++)
+            {
+                advectKernels->rk4Line(dest.line(i, j), source.view(), u.view(), v.view(), w.view(),
+                                       i, j, 1, depth - 1, dt0);
+            }
+        }
+    });
+}
+
+// Project velocity to be divergence-free, as FluidSim::project does with the
+// Gauss-Seidel solver
+void FluidSim3D::project(VolumeField &u, VolumeField &v, VolumeField &w, VolumeField &p, VolumeField &div)
+{
+    float h = 1.0f / width;
+
+    threadPool->parallelFor(1, width - 1, [&](int sliceBegin, int sliceEnd)
+    {
+        for (int i = sliceBegin; i < sliceEnd; i++)
+        {
+            for (int j = 1; j < height - 1; j++)
+            {
+                const float *uLeft = u.line(i - 1, j);
+                const float *uRight = u.line(i + 1, j);
+                const float *vDown = v.line(i, j - 1);
+                const float *vUp = v.line(i, j + 1);
+                const float *wLine = w.line(i, j);
+                float *d = div.line(i, j);
+                float *pLine = p.line(i, j);
+                for (int k = 1; k < depth - 1; k++)
+                {
+                    d[k] = -0.5f * h * (uRight[k] - uLeft[k] + vUp[k] - vDown[k] + wLine[k + 1] - wLine[k - 1]);
+                    pLine[k] = 0;
+                }
+            }
+        }
+    });
+    applyBoundary(0, div);
+    applyBoundary(0, p);
+
+    // Red-black ordered so each half-sweep can run in parallel
+    for (int sweep = 0; sweep < pressureIterations; sweep++)
+    {
+        for (int color = 0; color < 2; color++)
+        {
+            threadPool->parallelFor(1, width - 1, [&](int sliceBegin, int sliceEnd)
+            {
+                for (int i = sliceBegin; i < sliceEnd; i++)
+                {
+                    for (int j = 1; j < height - 1; j++)
+                    {
+                        const float *neighbours[4] = {p.line(i + 1, j), p.line(i - 1, j), p.line(i, j + 1),
+                                                      p.line(i, j - 1)};
+                        advectKernels->gaussSeidelLine(p.line(i, j), div.line(i, j), neighbours, 4,
+                                                       1 + ((i + j + 1 + color) & 1), depth - 1, 6.0f);
+                    }
+                }
+            });
+        }
+        applyBoundary(0, p);
+    }
+
+    // Apply pressure gradient to velocity
+    threadPool->parallelFor(1, width - 1, [&](int sliceBegin, int sliceEnd)
+    {
+        for (int i = sliceBegin; i < sliceEnd; i++)
+        {
+            for (int j = 1; j < height - 1; j++)
+            {
+                const float *pLine = p.line(i, j);
+                const float *pLeft = p.line(i - 1, j);
+                const float *pRight = p.line(i + 1, j);
+                const float *pDown = p.line(i, j - 1);
+                const float *pUp = p.line(i, j + 1);
+                float *uLine = u.line(i, j);
+                float *vLine = v.line(i, j);
+                float *wLine = w.line(i, j);
+                for (int k = 1; k < depth - 1; k++)
+                {
+                    uLine[k] -= 0.5f * (pRight[k] - pLeft[k]) / h;
+                    vLine[k] -= 0.5f * (pUp[k] - pDown[k]) / h;
+                    wLine[k] -= 0.5f * (pLine[k + 1] - pLine[k - 1]) / h;
+                }
+            }
+        }
+    });
+    applyBoundary(1, u);
+    applyBoundary(2, v);
+    applyBoundary(3, w);
+}
+
+void FluidSim3D::velocityStep(float dt)
+{
+    prevVelocityX.copyFrom(velocityX);
+    prevVelocityY.copyFrom(velocityY);
+    prevVelocityZ.copyFrom(velocityZ);
+
+    diffuse(1, velocityX, prevVelocityX, viscosity, dt);
+    diffuse(2, velocityY, prevVelocityY, viscosity, dt);
+    diffuse(3, velocityZ, prevVelocityZ, viscosity, dt);
+
+    project(velocityX, velocityY, velocityZ, prevVelocityX, prevVelocityY);
+
+    prevVelocityX.copyFrom(velocityX);
+    prevVelocityY.copyFrom(velocityY);
+    prevVelocityZ.copyFrom(velocityZ);
+
+    advect(velocityScheme, 1, velocityX, prevVelocityX, prevVelocityX, prevVelocityY, prevVelocityZ, dt);
+    advect(velocityScheme, 2, velocityY, prevVelocityY, prevVelocityX, prevVelocityY, prevVelocityZ, dt);
+    advect(velocityScheme, 3, velocityZ, prevVelocityZ, prevVelocityX, prevVelocityY, prevVelocityZ, dt);
+
+    project(velocityX, velocityY, velocityZ, prevVelocityX, prevVelocityY);
+}
+
+void FluidSim3D::densityStep(float dt)
+{
+    prevDensity.copyFrom(density);
+    diffuse(0, density, prevDensity, diffusion, dt);
+    prevDensity.copyFrom(density);
+    advect(densityScheme, 0, density, prevDensity, velocityX, velocityY, velocityZ, dt);
+}
+
+void FluidSim3D::addDensity(int x, int y, int z, float amount)
+{
+    if (x >= 0 && x < width && y >= 0 && y < height && z >= 0 && z < depth)
+    {
+        density(x, y, z) += amount;
+    }
+}
+
+void FluidSim3D::addVelocity(int x, int y, int z, float amountX, float amountY, float amountZ)
+{
+    if (x >= 0 && x < width && y >= 0 && y < height && z >= 0 && z < depth)
+    {
+        velocityX(x, y, z) += amountX;
+        velocityY(x, y, z) += amountY;
+        velocityZ(x, y, z) += amountZ;
+    }
+}
+
+float FluidSim3D::getDensity(int x, int y, int z) const
+{
+    if (x >= 0 && x < width && y >= 0 && y < height && z >= 0 && z < depth)
+    {
+        return density(x, y, z);
+    }
+    return 0.0f;
+}
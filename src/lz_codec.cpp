@@ -0,0 +1,164 @@
+#include "lz_codec.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+const std::size_t MIN_MATCH = 4;
+const std::size_t MAX_OFFSET = 65535;
+
+std::uint32_t load32(const std::uint8_t *p)
+{
+    std::uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// Lengths of 15 and up continue in bytes of 255 ended by one below 255
+void writeLength(std::vector<std::uint8_t> &out, std::size_t length)
+{
+    for (; length >= 255; length -= 255)
+    {
+        out.push_back(255);
+    }
+    out.push_back(static_cast<std::uint8_t>(length));
+}
+
+void writeSequence(std::vector<std::uint8_t> &out, const std::uint8_t *literals, std::size_t literalCount,
+                   std::size_t offset, std::size_t matchLength)
+{
+    std::size_t matchCode = matchLength >= MIN_MATCH ? matchLength - MIN_MATCH : 0;
+    out.push_back(static_cast<std::uint8_t>((std::min<std::size_t>(literalCount, 15) << 4) |
+                                            std::min<std::size_t>(matchCode, 15)));
+    if (literalCount >= 15)
+        writeLength(out, literalCount - 15);
+    out.insert(out.end(), literals, literals + literalCount);
+
+    if (matchLength < MIN_MATCH)
+        return;
+    out.push_back(static_cast<std::uint8_t>(offset & 0xff));
+    out.push_back(static_cast<std::uint8_t>(offset >> 8));
+    if (matchCode >= 15)
+        writeLength(out, matchCode - 15);
+}
+
+// Length of the common prefix of a and b, read up to end; a is below b.
+// Words are compared little-endian, so the first differing byte is the
+// lowest set one.
+std::size_t commonPrefix(const std::uint8_t *a, const std::uint8_t *b, const std::uint8_t *end)
+{
+    const std::uint8_t *start = b;
+    while (end - b >= 8)
+    {
+        std::uint64_t x, y;
+        std::memcpy(&x, a, sizeof(x));
+        std::memcpy(&y, b, sizeof(y));
+        if (x != y)
+            return b - start + (__builtin_ctzll(x ^ y) >> 3);
+        a += 8;
+        b += 8;
+    }
+    while (b < end && *a == *b)
+    {
+        a++;
+        b++;
+    }
+    return b - start;
+}
+
+bool readLength(const std::uint8_t *&in, const std::uint8_t *end, std::size_t &length)
+{
+    std::uint8_t byte;
+    do
+    {
+        if (in == end)
+            return false;
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+}
+
+void LzCompressor::compress(const std::uint8_t *in, std::size_t size, std::vector<std::uint8_t> &out)
+{
+    out.clear();
+    out.reserve(size + size / 255 + 16);
+    table.assign(std::size_t(1) << HASH_BITS, 0);
+
+    std::size_t anchor = 0;
+    std::size_t i = 0;
+    std::size_t misses = 0;
+    while (i + MIN_MATCH <= size)
+    {
+        std::uint32_t sequence = load32(in + i);
+        std::uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+        std::size_t candidate = table[hash];
+        table[hash] = static_cast<std::uint32_t>(i + 1);
+
+        if (candidate == 0 || i - (candidate - 1) > MAX_OFFSET || load32(in + candidate - 1) != sequence)
+        {
+            // Skip ahead faster through data that does not compress
+            i += 1 + (misses++ >> 6);
+            continue;
+        }
+
+        std::size_t match = candidate - 1;
+        std::size_t length = commonPrefix(in + match + MIN_MATCH, in + i + MIN_MATCH, in + size) + MIN_MATCH;
+        writeSequence(out, in + anchor, i - anchor, i - match, length);
+        i += length;
+        anchor = i;
+        misses = 0;
+    }
+    writeSequence(out, in + anchor, size - anchor, 0, 0);
+}
+
+bool lzDecompress(const std::uint8_t *in, std::size_t inSize, std::uint8_t *out, std::size_t size)
+{
+    const std::uint8_t *end = in + inSize;
+    std::size_t written = 0;
+    while (in < end)
+    {
+        std::uint8_t token = *in++;
+
+        std::size_t literalCount = token >> 4;
+        if (literalCount == 15 && !readLength(in, end, literalCount))
+            return false;
+        if (literalCount > static_cast<std::size_t>(end - in) || literalCount > size - written)
+            return false;
+        std::memcpy(out + written, in, literalCount);
+        in += literalCount;
+        written += literalCount;
+
+        if (in == end)
+            break;
+
+        if (end - in < 2)
+            return false;
+        std::size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        std::size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(in, end, matchLength))
+            return false;
+        matchLength += MIN_MATCH;
+        if (offset == 0 || offset > written || matchLength > size - written)
+            return false;
+
+        // A match may overlap the bytes it produces; a run of one byte, the
+        // common case in delta-coded fields, is a fill
+        const std::uint8_t *source = out + written - offset;
+        if (offset == 1)
+        {
+            std::memset(out + written, *source, matchLength);
+        }
+        else
+        {
+            for (std::size_t k = 0; k < matchLength; k++)
+            {
+                out[written + k] = source[k];
+            }
+        }
+        written += matchLength;
+    }
+    return written == size;
+}
@@ -1,54 +1,123 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include "field_recorder.h"
 #include "fluid_sim.h"
+#include "simulation_thread.h"
 #include <vector>
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
 
 FluidSim sim;
 
+// Steps sim on its own thread at 100 steps of 0.01 per second, i.e. in real
+// time; the render loop only reads its frames and queues input
+SimulationThread simulation(sim, 0.01f, 100.0);
+
 // settings
 unsigned int SCR_WIDTH = 800;
 unsigned int SCR_HEIGHT = 600;
 
 // Shader sources
-unsigned int densityShaderProgram, densityVAO, densityVBO;
-unsigned int velocityShaderProgram, velocityVAO, velocityVBO;
+unsigned int densityShaderProgram, densityVAO;
+unsigned int velocityShaderProgram, velocityVAO;
+
+// A simulation field mirrored into a single-channel float texture, refilled
+// each frame through two alternating pixel buffers so writing one never waits
+// for the upload from the other. Texture rows hold grid rows (fixed x).
+struct FieldTexture
+{
+    unsigned int texture = 0;
+    unsigned int pbos[2] = {0, 0};
+    int pboIndex = 0;
+    int width = 0, height = 0; // Grid size; 0 until first uploaded
+};
+
+FieldTexture densityTexture, velocityXTexture, velocityYTexture;
+
+// Cells between neighbouring velocity glyphs along each axis
+const int GLYPH_SPACING = 2;
 
 // Visualization toggle
 bool showVelocityVectors = false;
 
-// Additional shader for density field visualization
+// Density field shaders: one full-screen quad sampling the density texture
 const char *densityVertexShaderSource = R"(
     #version 330 core
-    layout (location = 0) in vec2 aPos;
-    layout (location = 1) in float aDensity;
-    out float density;
+    out vec2 uv;
     void main() {
-        gl_Position = vec4(aPos, 0.0, 1.0);
-        density = aDensity;
+        // Corners of the quad from the vertex index, drawn as a triangle strip
+        vec2 pos = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+        uv = pos * 0.5 + 0.5;
+        gl_Position = vec4(pos, 0.0, 1.0);
     }
 )";
 
 const char *densityFragmentShaderSource = R"(
     #version 330 core
-    in float density;
+    in vec2 uv;
+    uniform sampler2D densityTexture;
     out vec4 FragColor;
     void main() {
+        // The field is stored x-major, so texture rows run along grid y
+        float density = texture(densityTexture, uv.yx).r;
+
+        // Leave cells with no density transparent
+        if (density < 0.01)
+            discard;
+
         // Colormap for density visualization (blue to red)
         vec3 color = mix(vec3(0.0, 0.0, 1.0), vec3(1.0, 0.0, 0.0), density);
         FragColor = vec4(color, min(density * 2.0, 0.8));
     }
 )";
 
-// Velocity vector visualization shaders
+// Velocity glyph shaders: one instanced line per sampled cell, with direction,
+// length and color computed from the velocity textures
 const char *velocityVertexShaderSource = R"(
     #version 330 core
-    layout (location = 0) in vec2 aPos;
-    layout (location = 1) in vec3 aColor;
+    uniform sampler2D velocityXTexture;
+    uniform sampler2D velocityYTexture;
+    uniform ivec2 gridSize;
+    uniform int glyphSpacing;
     out vec3 color;
+
+    // Color gradient from blue (slow) to red (fast):
+    // Blue -> Cyan -> Green -> Yellow -> Red
+    vec3 speedColor(float speed) {
+        float t = min(speed / 10.0, 1.0);
+        if (t < 0.25)
+            return vec3(0.0, t / 0.25, 1.0);
+        if (t < 0.5)
+            return vec3(0.0, 1.0, 1.0 - (t - 0.25) / 0.25);
+        if (t < 0.75)
+            return vec3((t - 0.5) / 0.25, 1.0, 0.0);
+        return vec3(1.0, 1.0 - (t - 0.75) / 0.25, 0.0);
+    }
+
     void main() {
-        gl_Position = vec4(aPos, 0.0, 1.0);
-        color = aColor;
+        int columns = (gridSize.y + glyphSpacing - 1) / glyphSpacing;
+        ivec2 cell = ivec2(gl_InstanceID / columns, gl_InstanceID % columns) * glyphSpacing;
+
+        // Textures are indexed (y, x) since the fields are stored x-major
+        vec2 velocity = vec2(texelFetch(velocityXTexture, cell.yx, 0).r,
+                             texelFetch(velocityYTexture, cell.yx, 0).r);
+        float magnitude = length(velocity);
+
+        // Skip cells with very low velocity by moving the line out of view
+        if (magnitude < 0.1) {
+            gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+            color = vec3(0.0);
+            return;
+        }
+
+        // Line from the center of the cell in the direction of the velocity
+        vec2 center = (vec2(cell) + 0.5) / vec2(gridSize) * 2.0 - 1.0;
+        vec2 end = center + velocity / magnitude * 0.05;
+        gl_Position = vec4(gl_VertexID == 0 ? center : end, 0.0, 1.0);
+        color = speedColor(magnitude);
     }
 )";
 
@@ -155,13 +224,80 @@ void setupShaders()
     glDeleteShader(velocityVertexShader);
     glDeleteShader(velocityFragmentShader);
 
-    // Create density field buffers
-    glGenVertexArrays(1, &densityVAO);
-    glGenBuffers(1, &densityVBO);
+    // Texture units of the samplers
+    glUseProgram(densityShaderProgram);
+    glUniform1i(glGetUniformLocation(densityShaderProgram, "densityTexture"), 0);
+    glUseProgram(velocityShaderProgram);
+    glUniform1i(glGetUniformLocation(velocityShaderProgram, "velocityXTexture"), 0);
+    glUniform1i(glGetUniformLocation(velocityShaderProgram, "velocityYTexture"), 1);
 
-    // Create velocity vector buffers
+    // Neither the density quad nor the glyphs have vertex attributes, but
+    // core profile still needs a vertex array bound to draw
+    glGenVertexArrays(1, &densityVAO);
     glGenVertexArrays(1, &velocityVAO);
-    glGenBuffers(1, &velocityVBO);
+}
+
+// Allocate a field texture and its pixel buffers for the given grid
+void createFieldTexture(FieldTexture &target, const FieldView &field)
+{
+    target.width = field.width;
+    target.height = field.height;
+
+    glGenTextures(1, &target.texture);
+    glBindTexture(GL_TEXTURE_2D, target.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, field.height, field.width, 0, GL_RED, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    GLsizeiptr bytes = static_cast<GLsizeiptr>(field.stride) * field.width * sizeof(float);
+    glGenBuffers(2, target.pbos);
+    for (unsigned int pbo : target.pbos)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void deleteFieldTexture(FieldTexture &target)
+{
+    if (target.width == 0)
+        return;
+    glDeleteTextures(1, &target.texture);
+    glDeleteBuffers(2, target.pbos);
+    target = FieldTexture();
+}
+
+// Copy a field into the texture's next pixel buffer and start the upload
+// from it; the CPU cost is one memcpy of the field
+void uploadFieldTexture(FieldTexture &target, const FieldView &field)
+{
+    if (field.width != target.width || field.height != target.height)
+    {
+        deleteFieldTexture(target);
+        createFieldTexture(target, field);
+    }
+
+    GLsizeiptr bytes = static_cast<GLsizeiptr>(field.stride) * field.width * sizeof(float);
+    target.pboIndex ^= 1;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, target.pbos[target.pboIndex]);
+
+    // Invalidating lets the driver hand out fresh storage instead of
+    // waiting for a transfer that still reads the old contents
+    void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped)
+    {
+        std::memcpy(mapped, field.data, bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+        glBindTexture(GL_TEXTURE_2D, target.texture);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, field.stride);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, field.height, field.width, GL_RED, GL_FLOAT, (void *)0);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 }
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height)
@@ -175,6 +311,7 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height)
 double lastMouseX = 0.0, lastMouseY = 0.0;
 bool mouseLeftPressed = false;
 bool mouseRightPressed = false;
+bool mouseMiddlePressed = false;
 bool firstMouse = true;
 
 // Mouse callback function
@@ -204,28 +341,20 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos)
         float normY = 1.0f - (2.0f * ypos / SCR_HEIGHT);
 
         // Convert normalized coordinates to grid coordinates
-        int gridX = static_cast<int>((normX + 1.0f) * 0.5f * GRID_SIZE_X);
-        int gridY = static_cast<int>((normY + 1.0f) * 0.5f * GRID_SIZE_Y);
+        SimInput input{SimInput::Kind::Splat};
+        input.splat.x = (normX + 1.0f) * 0.5f * sim.getWidth();
+        input.splat.y = (normY + 1.0f) * 0.5f * sim.getHeight();
+        // A disc covering about the 7x7 cells the brush used to paint
+        input.splat.shape = SplatShape::Disc;
+        input.splat.radius = 4.0f;
 
         // Add velocity in the direction of mouse movement
         float velocityScaleFactor = 10.0f;
-        float dx = deltaX / SCR_WIDTH * velocityScaleFactor;
-        float dy = -deltaY / SCR_HEIGHT * velocityScaleFactor; // Invert Y for screen coordinates
+        input.splat.velocityX = deltaX / SCR_WIDTH * velocityScaleFactor;
+        input.splat.velocityY = -deltaY / SCR_HEIGHT * velocityScaleFactor; // Invert Y for screen coordinates
 
-        // Apply velocity and density to a small area around the cursor
-        for (int i = -3; i <= 3; i++)
-        {
-            for (int j = -3; j <= 3; j++)
-            {
-                int x = gridX + i;
-                int y = gridY + j;
-                if (x >= 0 && x < GRID_SIZE_X && y >= 0 && y < GRID_SIZE_Y)
-                {
-                    // Use the public methods we added
-                    sim.addVelocity(x, y, dx, dy);
-                }
-            }
-        }
+        // Apply velocity to a small area around the cursor
+        simulation.pushInput(input);
     } else if (mouseRightPressed)
     {
         // Convert screen coordinates to simulation space (-1,1)
@@ -233,23 +362,27 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos)
         float normY = 1.0f - (2.0f * ypos / SCR_HEIGHT);
 
         // Convert normalized coordinates to grid coordinates
-        int gridX = static_cast<int>((normX + 1.0f) * 0.5f * GRID_SIZE_X);
-        int gridY = static_cast<int>((normY + 1.0f) * 0.5f * GRID_SIZE_Y);
+        SimInput input{SimInput::Kind::Splat};
+        input.splat.x = (normX + 1.0f) * 0.5f * sim.getWidth();
+        input.splat.y = (normY + 1.0f) * 0.5f * sim.getHeight();
+        input.splat.shape = SplatShape::Disc;
+        input.splat.radius = 4.0f;
 
         // Apply density to a small area around the cursor
-        for (int i = -3; i <= 3; i++)
-        {
-            for (int j = -3; j <= 3; j++)
-            {
-                int x = gridX + i;
-                int y = gridY + j;
-                if (x >= 0 && x < GRID_SIZE_X && y >= 0 && y < GRID_SIZE_Y)
-                {
-                    // Use the public methods we added
-                    sim.addDensity(x, y, 1.0f);
-                }
-            }
-        }
+        input.splat.density = 1.0f;
+        simulation.pushInput(input);
+    } else if (mouseMiddlePressed)
+    {
+        // Convert screen coordinates to simulation space (-1,1)
+        float normX = (2.0f * xpos / SCR_WIDTH) - 1.0f;
+        float normY = 1.0f - (2.0f * ypos / SCR_HEIGHT);
+
+        // Draw a solid obstacle under the cursor
+        SimInput input{SimInput::Kind::Obstacle};
+        input.splat.x = (normX + 1.0f) * 0.5f * sim.getWidth();
+        input.splat.y = (normY + 1.0f) * 0.5f * sim.getHeight();
+        input.splat.radius = 4.0f;
+        simulation.pushInput(input);
     }
 }
 
@@ -275,6 +408,15 @@ void mouse_button_callback(GLFWwindow *window, int button, int action, int mods)
         {
             mouseRightPressed = false;
         }
+    } else if (button == GLFW_MOUSE_BUTTON_MIDDLE) {
+        if (action == GLFW_PRESS)
+        {
+            mouseMiddlePressed = true;
+        }
+        else if (action == GLFW_RELEASE)
+        {
+            mouseMiddlePressed = false;
+        }
     }
 }
 
@@ -286,10 +428,16 @@ void processInput(GLFWwindow *window)
     // Reset simulation with R key
     if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
     {
-        sim = FluidSim();
+        simulation.pushInput({SimInput::Kind::Reset});
         std::cout << "Simulation reset" << std::endl;
     }
 
+    // Remove the obstacles with C key
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS)
+    {
+        simulation.pushInput({SimInput::Kind::ClearObstacles});
+    }
+
     // Toggle velocity vector visualization with V key
     static bool vKeyPressed = false;
     if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS && !vKeyPressed)
@@ -304,8 +452,78 @@ void processInput(GLFWwindow *window)
     }
 }
 
-int main()
+// Next frame of a recording, starting over after the last one
+const SimFrame &nextPlaybackFrame(RecordingReader &player, SimFrame &frame)
+{
+    if (!player.next(frame))
+    {
+        player.rewind();
+        player.next(frame);
+    }
+    return frame;
+}
+
+int main(int argc, char **argv)
 {
+    // Optional grid resolution or starting snapshot, and a file to record
+    // the displayed frames to or to play back instead of simulating:
+    // fluid_sim [width height | checkpoint] [--record FILE | --play FILE]
+    std::string recordPath, playPath;
+    std::vector<char *> positional;
+    for (int k = 1; k < argc; k++)
+    {
+        std::string arg = argv[k];
+        if (arg == "--record" && k + 1 < argc)
+            recordPath = argv[++k];
+        else if (arg == "--play" && k + 1 < argc)
+            playPath = argv[++k];
+        else
+            positional.push_back(argv[k]);
+    }
+
+    bool warmStart = false;
+    std::unique_ptr<FieldRecorder> recorder;
+    std::unique_ptr<RecordingReader> player;
+    SimFrame playbackFrame;
+    try
+    {
+        if (positional.size() == 1)
+        {
+            sim.loadCheckpoint(positional[0]);
+            warmStart = true;
+        }
+        else if (positional.size() == 2)
+        {
+            int gridWidth = std::atoi(positional[0]);
+            int gridHeight = std::atoi(positional[1]);
+            if (gridWidth < 3 || gridHeight < 3)
+            {
+                std::cout << "Invalid grid size " << positional[0] << "x" << positional[1] << std::endl;
+                return -1;
+            }
+            sim.resize(gridWidth, gridHeight);
+        }
+
+        if (!playPath.empty())
+        {
+            player = std::make_unique<RecordingReader>(playPath);
+            if (!player->next(playbackFrame))
+            {
+                std::cout << "Recording " << playPath << " has no frames" << std::endl;
+                return -1;
+            }
+        }
+        else if (!recordPath.empty())
+        {
+            recorder = std::make_unique<FieldRecorder>(recordPath, sim.getWidth(), sim.getHeight());
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << e.what() << std::endl;
+        return -1;
+    }
+
     if (!glfwInit())
     {
         return -1;
@@ -348,20 +566,29 @@ int main()
     setupShaders();
 
     // Add initial density and velocity for benchmarking
-    int centerX = sim.getWidth() / 2;
-    int centerY = sim.getHeight() / 2;
-    for (int i = -5; i <= 5; i++)
+    if (!warmStart)
     {
-        for (int j = -5; j <= 5; j++)
-        {
-            if (i * i + j * j < 25)
-            { // circular area
-                sim.addDensity(centerX + i, centerY + j, 10.0f);
-                sim.addVelocity(centerX + i, centerY + j, 0.0f, 2.0f);
-            }
-        }
+        Splat blob;
+        blob.shape = SplatShape::Disc;
+        blob.x = static_cast<float>(sim.getWidth() / 2);
+        blob.y = static_cast<float>(sim.getHeight() / 2);
+        blob.radius = 5.0f;
+        blob.density = 10.0f;
+        blob.velocityY = 2.0f;
+        sim.addSplat(blob);
     }
 
+    // Split steps when fast flow would move more than two cells per step
+    TimestepSettings timestep;
+    timestep.adaptive = true;
+    timestep.targetCfl = 2.0f;
+    sim.setTimestepSettings(timestep);
+
+    // From here on only the simulation thread touches sim
+    if (!player)
+        simulation.start();
+    long long recordedStep = -1;
+
     // Run for 10s for benchmarking
     double startTime = glfwGetTime();
     while (!glfwWindowShouldClose(window)/* && (glfwGetTime() - startTime < 10.0)*/)
@@ -376,141 +603,48 @@ int main()
         glEnable(GL_BLEND);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-        // Step the simulation
-        sim.step(0.01f);
-
-        // Render the density field as a grid of quads
-        int width = sim.getWidth();
-        int height = sim.getHeight();
-        std::vector<float> densityVertices;
+        // Latest state finished by the simulation thread, or the next
+        // recorded one
+        const SimFrame &frame = player ? nextPlaybackFrame(*player, playbackFrame) : simulation.acquireFrame();
 
-        // Create a vertex for each density cell (with normalized coordinates)
-        for (int i = 0; i < width; i++)
+        // Queue each new displayed state for the recorder's writer thread
+        if (recorder && frame.step != recordedStep)
         {
-            for (int j = 0; j < height; j++)
-            {
-                float x = (float)i / width * 2.0f - 1.0f;
-                float y = (float)j / height * 2.0f - 1.0f;
-                float cellWidth = 2.0f / width;
-                float cellHeight = 2.0f / height;
-                float density = sim.getDensity(i, j);
-
-                // Skip cells with no density for efficiency
-                if (density < 0.01f)
-                    continue;
-
-                // Create a quad for this cell
-                // Triangle 1
-                densityVertices.push_back(x);
-                densityVertices.push_back(y);
-                densityVertices.push_back(density);
-
-                densityVertices.push_back(x + cellWidth);
-                densityVertices.push_back(y);
-                densityVertices.push_back(density);
-
-                densityVertices.push_back(x);
-                densityVertices.push_back(y + cellHeight);
-                densityVertices.push_back(density);
-
-                // Triangle 2
-                densityVertices.push_back(x + cellWidth);
-                densityVertices.push_back(y);
-                densityVertices.push_back(density);
-
-                densityVertices.push_back(x + cellWidth);
-                densityVertices.push_back(y + cellHeight);
-                densityVertices.push_back(density);
-
-                densityVertices.push_back(x);
-                densityVertices.push_back(y + cellHeight);
-                densityVertices.push_back(density);
-            }
+            recorder->offer(frame.density.view(), frame.velocityX.view(), frame.velocityY.view(), frame.step);
+            recordedStep = frame.step;
         }
 
-        // Render density field if we have any vertices
-        if (!densityVertices.empty())
-        {
-            glBindVertexArray(densityVAO);
-            glBindBuffer(GL_ARRAY_BUFFER, densityVBO);
-            glBufferData(GL_ARRAY_BUFFER, densityVertices.size() * sizeof(float), densityVertices.data(), GL_DYNAMIC_DRAW);
-
-            // Position attribute
-            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-            glEnableVertexAttribArray(0);
+        // Render the density field as a texture on a full-screen quad
+        uploadFieldTexture(densityTexture, frame.density.view());
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, densityTexture.texture);
+        glUseProgram(densityShaderProgram);
+        glBindVertexArray(densityVAO);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
-            // Density attribute
-            glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)(2 * sizeof(float)));
-            glEnableVertexAttribArray(1);
-
-            // Draw the density field
-            glUseProgram(densityShaderProgram);
-            glDrawArrays(GL_TRIANGLES, 0, densityVertices.size() / 3);
-        }
-
-        // Render velocity vectors if enabled
+        // Render velocity vectors if enabled: one line instance per sampled
+        // cell, built entirely in the vertex shader
         if (showVelocityVectors)
         {
-            std::vector<float> velocityVertices;
-            
-            // Create velocity vector lines
-            for (int i = 0; i < width; i += 2) // Sample every 2nd cell for better visibility
-            {
-                for (int j = 0; j < height; j += 2)
-                {
-                    glm::vec2 normalizedVel = sim.getNormalizedVelocity(i, j);
-                    float magnitude = sim.getVelocityMagnitude(i, j);
-                    
-                    // Skip cells with very low velocity
-                    if (magnitude < 0.1f)
-                        continue;
-                        
-                    glm::vec3 color = sim.getVelocityColor(i, j);
-                    
-                    // Convert grid coordinates to normalized screen coordinates
-                    float centerX = (float)i / width * 2.0f - 1.0f + (1.0f / width);
-                    float centerY = (float)j / height * 2.0f - 1.0f + (1.0f / height);
-                    
-                    // Scale the vector for visualization
-                    float scale = 0.05f; // Adjust this to make vectors longer/shorter
-                    float endX = centerX + normalizedVel.x * scale;
-                    float endY = centerY + normalizedVel.y * scale;
-                    
-                    // Line from center of cell to direction of velocity
-                    velocityVertices.push_back(centerX);
-                    velocityVertices.push_back(centerY);
-                    velocityVertices.push_back(color.r);
-                    velocityVertices.push_back(color.g);
-                    velocityVertices.push_back(color.b);
-                    
-                    velocityVertices.push_back(endX);
-                    velocityVertices.push_back(endY);
-                    velocityVertices.push_back(color.r);
-                    velocityVertices.push_back(color.g);
-                    velocityVertices.push_back(color.b);
-                }
-            }
-            
-            if (!velocityVertices.empty())
-            {
-                // Upload velocity vector data
-                glBindVertexArray(velocityVAO);
-                glBindBuffer(GL_ARRAY_BUFFER, velocityVBO);
-                glBufferData(GL_ARRAY_BUFFER, velocityVertices.size() * sizeof(float), velocityVertices.data(), GL_DYNAMIC_DRAW);
-                
-                // Position attribute
-                glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)0);
-                glEnableVertexAttribArray(0);
-                
-                // Color attribute
-                glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)(2 * sizeof(float)));
-                glEnableVertexAttribArray(1);
-                
-                // Draw the velocity vectors
-                glUseProgram(velocityShaderProgram);
-                glLineWidth(2.0f);
-                glDrawArrays(GL_LINES, 0, velocityVertices.size() / 5);
-            }
+            uploadFieldTexture(velocityXTexture, frame.velocityX.view());
+            uploadFieldTexture(velocityYTexture, frame.velocityY.view());
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, velocityXTexture.texture);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, velocityYTexture.texture);
+            glActiveTexture(GL_TEXTURE0);
+
+            int width = frame.velocityX.getWidth();
+            int height = frame.velocityX.getHeight();
+            int glyphRows = (width + GLYPH_SPACING - 1) / GLYPH_SPACING;
+            int glyphColumns = (height + GLYPH_SPACING - 1) / GLYPH_SPACING;
+
+            glUseProgram(velocityShaderProgram);
+            glUniform2i(glGetUniformLocation(velocityShaderProgram, "gridSize"), width, height);
+            glUniform1i(glGetUniformLocation(velocityShaderProgram, "glyphSpacing"), GLYPH_SPACING);
+            glBindVertexArray(velocityVAO);
+            glLineWidth(2.0f);
+            glDrawArraysInstanced(GL_LINES, 0, 2, glyphRows * glyphColumns);
         }
 
         // check and call events and swap the buffers
@@ -519,12 +653,27 @@ int main()
     }
 
     // Cleanup
+    simulation.stop();
+    if (recorder)
+    {
+        try
+        {
+            recorder->close();
+            std::cout << "Recorded " << recorder->getRecordedCount() << " frames (" << recorder->getDroppedCount()
+                      << " dropped) to " << recordPath << std::endl;
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << e.what() << std::endl;
+        }
+    }
     glDeleteVertexArrays(1, &densityVAO);
-    glDeleteBuffers(1, &densityVBO);
+    deleteFieldTexture(densityTexture);
     glDeleteProgram(densityShaderProgram);
     
     glDeleteVertexArrays(1, &velocityVAO);
-    glDeleteBuffers(1, &velocityVBO);
+    deleteFieldTexture(velocityXTexture);
+    deleteFieldTexture(velocityYTexture);
     glDeleteProgram(velocityShaderProgram);
 
     glfwDestroyWindow(window);
@@ -0,0 +1,275 @@
+#include "multigrid.h"
+#include <algorithm>
+#include <cmath>
+
+void MultigridSolver::resize(int width, int height)
+{
+    levels.clear();
+
+    // Level 0 is the caller's grid; only its residual is stored here
+    levels.emplace_back();
+    levels.back().residual.resize(width, height);
+
+    // Halve the interior until the coarsest level is a handful of cells wide
+    int nx = width - 2;
+    int ny = height - 2;
+    while (std::min(nx, ny) > 3)
+    {
+        nx = (nx + 1) / 2;
+        ny = (ny + 1) / 2;
+
+        levels.emplace_back();
+        Level &level = levels.back();
+        level.solution.resize(nx + 2, ny + 2);
+        level.rhs.resize(nx + 2, ny + 2);
+        level.residual.resize(nx + 2, ny + 2);
+    }
+}
+
+SolverStats MultigridSolver::solve(Field &p, const Field &rhs, const MultigridSettings &settings)
+{
+    SolverStats stats;
+    if (levels.empty() || levels[0].residual.getWidth() != p.getWidth() ||
+        levels[0].residual.getHeight() != p.getHeight())
+    {
+        resize(p.getWidth(), p.getHeight());
+    }
+
+    if (settings.fullMultigrid && levels.size() > 1)
+    {
+        // Restrict the right-hand side down the whole hierarchy
+        restrictToCoarse(rhs, levels[1].rhs);
+        for (size_t l = 2; l < levels.size(); l++)
+        {
+            restrictToCoarse(levels[l - 1].rhs, levels[l].rhs);
+        }
+
+        // Solve on the coarsest level, then interpolate each solution up as
+        // the initial guess for a V-cycle on the next finer level
+        Level &coarsest = levels.back();
+        coarsest.solution.fill(0.0f);
+        solveCoarsest(coarsest.solution, coarsest.rhs, settings.coarseSweeps);
+
+        for (size_t l = levels.size() - 2; l >= 1; l--)
+        {
+            levels[l].solution.fill(0.0f);
+            prolongAdd(levels[l + 1].solution, levels[l].solution);
+            vCycle(static_cast<int>(l), levels[l].solution, levels[l].rhs, settings);
+        }
+
+        p.fill(0.0f);
+        prolongAdd(levels[1].solution, p);
+        vCycle(0, p, rhs, settings);
+        stats.iterations++;
+    }
+
+    // Largest residual relative to the largest right-hand side value
+    float rhsNorm = maxAbs(rhs);
+    auto relativeResidual = [&]()
+    {
+        computeResidual(p, rhs, levels[0].residual);
+        float norm = maxAbs(levels[0].residual);
+        return rhsNorm > 0.0f ? norm / rhsNorm : norm;
+    };
+
+    // The starting residual only matters when it can end the solve early,
+    // or when no V-cycle follows to measure one
+    if (settings.tolerance > 0.0f || settings.vCycles <= 0)
+        stats.residual = relativeResidual();
+    for (int k = 0; k < settings.vCycles; k++)
+    {
+        if (settings.tolerance > 0.0f && stats.residual <= settings.tolerance)
+            break;
+        vCycle(0, p, rhs, settings);
+        stats.iterations++;
+        stats.residual = relativeResidual();
+    }
+    return stats;
+}
+
+void MultigridSolver::vCycle(int level, Field &p, const Field &rhs, const MultigridSettings &settings)
+{
+    if (level == static_cast<int>(levels.size()) - 1)
+    {
+        // Copy so the coarsest solve can make the right-hand side consistent
+        Field &coarseRhs = levels[level].residual;
+        coarseRhs.copyFrom(rhs);
+        solveCoarsest(p, coarseRhs, settings.coarseSweeps);
+        return;
+    }
+
+    smooth(p, rhs, settings.preSmooth);
+
+    // Restrict the residual and solve for the error on the next level
+    Level &coarse = levels[level + 1];
+    computeResidual(p, rhs, levels[level].residual);
+    restrictToCoarse(levels[level].residual, coarse.rhs);
+    coarse.solution.fill(0.0f);
+    vCycle(level + 1, coarse.solution, coarse.rhs, settings);
+
+    prolongAdd(coarse.solution, p);
+    smooth(p, rhs, settings.postSmooth);
+}
+
+// Red-black Gauss-Seidel relaxation
+void MultigridSolver::smooth(Field &p, const Field &rhs, int sweeps)
+{
+    int width = p.getWidth();
+    int height = p.getHeight();
+
+    for (int k = 0; k < sweeps; k++)
+    {
+        for (int color = 0; color < 2; color++)
+        {
+            parallelFor(threadPool, 1, width - 1, [&](int rowBegin, int rowEnd)
+            {
+                for (int i = rowBegin; i < rowEnd; i++)
+                {
+                    // First interior j whose (i + j) parity matches this color
+                    for (int j = 1 + ((i + 1 + color) & 1); j < height - 1; j += 2)
+                    {
+                        p(i, j) = (rhs(i, j) + p(i + 1, j) + p(i - 1, j) +
+                                   p(i, j + 1) + p(i, j - 1)) *
+                                  0.25f;
+                    }
+                }
+            });
+        }
+        applyBoundary(0, p);
+    }
+}
+
+void MultigridSolver::computeResidual(const Field &p, const Field &rhs, Field &residual)
+{
+    int width = p.getWidth();
+    int height = p.getHeight();
+
+    parallelFor(threadPool, 1, width - 1, [&](int rowBegin, int rowEnd)
+    {
+        for (int i = rowBegin; i < rowEnd; i++)
+        {
+            for (int j = 1; j < height - 1; j++)
+            {
+                residual(i, j) = rhs(i, j) - (4.0f * p(i, j) - p(i + 1, j) - p(i - 1, j) -
+                                              p(i, j + 1) - p(i, j - 1));
+            }
+        }
+    });
+}
+
+float MultigridSolver::maxAbs(const Field &field)
+{
+    return parallelMax(threadPool, 1, field.getWidth() - 1, [&](int rowBegin, int rowEnd)
+    {
+        float result = 0.0f;
+        for (int i = rowBegin; i < rowEnd; i++)
+        {
+            for (int j = 1; j < field.getHeight() - 1; j++)
+            {
+                result = std::max(result, std::fabs(field(i, j)));
+            }
+        }
+        return result;
+    });
+}
+
+// Sum the (up to) four fine cells under each coarse cell. The coarse grid has
+// twice the spacing, so the sum is the average scaled by h^2 = 4, which keeps
+// the same 5-point operator valid on every level.
+void MultigridSolver::restrictToCoarse(const Field &fine, Field &coarse)
+{
+    int fineWidth = fine.getWidth() - 1;
+    int fineHeight = fine.getHeight() - 1;
+
+    parallelFor(threadPool, 1, coarse.getWidth() - 1, [&](int rowBegin, int rowEnd)
+    {
+        for (int ci = rowBegin; ci < rowEnd; ci++)
+        {
+            int i0 = 2 * ci - 1;
+            int i1 = std::min(i0 + 1, fineWidth - 1);
+            for (int cj = 1; cj < coarse.getHeight() - 1; cj++)
+            {
+                int j0 = 2 * cj - 1;
+                int j1 = std::min(j0 + 1, fineHeight - 1);
+
+                float sum = fine(i0, j0);
+                if (j1 != j0)
+                    sum += fine(i0, j1);
+                if (i1 != i0)
+                {
+                    sum += fine(i1, j0);
+                    if (j1 != j0)
+                        sum += fine(i1, j1);
+                }
+                coarse(ci, cj) = sum;
+            }
+        }
+    });
+}
+
+// Bilinear interpolation of a cell-centred coarse field onto the fine cells.
+// Every smoothing pass ends with applyBoundary, so fine cells next to a wall
+// interpolate against the mirrored ghost values exactly as setBoundary sets.
+void MultigridSolver::prolongAdd(const Field &coarse, Field &fine)
+{
+    int fineWidth = fine.getWidth() - 1;
+    int fineHeight = fine.getHeight() - 1;
+
+    parallelFor(threadPool, 1, coarse.getWidth() - 1, [&](int rowBegin, int rowEnd)
+    {
+        for (int ci = rowBegin; ci < rowEnd; ci++)
+        {
+            for (int cj = 1; cj < coarse.getHeight() - 1; cj++)
+            {
+                float centre = coarse(ci, cj);
+                for (int di = 0; di < 2; di++)
+                {
+                    int fi = 2 * ci - 1 + di;
+                    if (fi >= fineWidth)
+                        continue;
+                    int ni = di == 0 ? ci - 1 : ci + 1;
+
+                    for (int dj = 0; dj < 2; dj++)
+                    {
+                        int fj = 2 * cj - 1 + dj;
+                        if (fj >= fineHeight)
+                            continue;
+                        int nj = dj == 0 ? cj - 1 : cj + 1;
+
+                        fine(fi, fj) += 0.5625f * centre +
+                                        0.1875f * (coarse(ni, cj) + coarse(ci, nj)) +
+                                        0.0625f * coarse(ni, nj);
+                    }
+                }
+            }
+        }
+    });
+    applyBoundary(0, fine);
+}
+
+void MultigridSolver::solveCoarsest(Field &p, Field &rhs, int sweeps)
+{
+    // The pure-Neumann problem is only solvable for a zero-mean right-hand
+    // side; remove the mean so relaxation converges instead of drifting
+    int width = rhs.getWidth();
+    int height = rhs.getHeight();
+    double sum = 0.0;
+    for (int i = 1; i < width - 1; i++)
+    {
+        for (int j = 1; j < height - 1; j++)
+        {
+            sum += rhs(i, j);
+        }
+    }
+    float mean = static_cast<float>(sum / ((width - 2) * (height - 2)));
+    for (int i = 1; i < width - 1; i++)
+    {
+        for (int j = 1; j < height - 1; j++)
+        {
+            rhs(i, j) -= mean;
+        }
+    }
+
+    applyBoundary(0, p);
+    smooth(p, rhs, sweeps);
+}
@@ -0,0 +1,209 @@
+#include "obstacle_mask.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+void ObstacleMask::resize(int newWidth, int newHeight)
+{
+    width = newWidth;
+    height = newHeight;
+    wordsPerRow = (height + 63) / 64;
+    bits.assign(static_cast<std::size_t>(width) * wordsPerRow, 0);
+    rowSolidCounts.assign(width, 0);
+    solidCount = 0;
+    solidRuns.clear();
+    for (std::vector<BoundaryCell> &cells : boundaryCells)
+    {
+        cells.clear();
+    }
+    changed = false;
+}
+
+void ObstacleMask::clear()
+{
+    if (solidCount == 0)
+        return;
+    std::fill(bits.begin(), bits.end(), 0);
+    std::fill(rowSolidCounts.begin(), rowSolidCounts.end(), 0);
+    solidCount = 0;
+    changed = true;
+}
+
+void ObstacleMask::set(int x, int y, bool solid)
+{
+    if (x < 1 || x >= width - 1 || y < 1 || y >= height - 1 || isSolid(x, y) == solid)
+        return;
+
+    bits[static_cast<std::size_t>(x) * wordsPerRow + (y >> 6)] ^= std::uint64_t(1) << (y & 63);
+    int delta = solid ? 1 : -1;
+    rowSolidCounts[x] += delta;
+    solidCount += delta;
+    changed = true;
+}
+
+void ObstacleMask::fillDisc(float x, float y, float radius, bool solid)
+{
+    int iBegin = std::max(1, static_cast<int>(std::ceil(x - radius)));
+    int iEnd = std::min(width - 1, static_cast<int>(std::floor(x + radius)) + 1);
+    int jBegin = std::max(1, static_cast<int>(std::ceil(y - radius)));
+    int jEnd = std::min(height - 1, static_cast<int>(std::floor(y + radius)) + 1);
+    for (int i = iBegin; i < iEnd; i++)
+    {
+        for (int j = jBegin; j < jEnd; j++)
+        {
+            float dx = i - x;
+            float dy = j - y;
+            if (dx * dx + dy * dy <= radius * radius)
+                set(i, j, solid);
+        }
+    }
+}
+
+void ObstacleMask::fillRect(int x0, int y0, int x1, int y1, bool solid)
+{
+    for (int i = std::max(1, x0); i < std::min(width - 1, x1); i++)
+    {
+        for (int j = std::max(1, y0); j < std::min(height - 1, y1); j++)
+        {
+            set(i, j, solid);
+        }
+    }
+}
+
+void ObstacleMask::loadBitmap(const unsigned char *pixels, int bitmapWidth, int bitmapHeight, int pitch)
+{
+    if (bitmapWidth <= 0 || bitmapHeight <= 0 || pitch < bitmapWidth)
+    {
+        throw std::invalid_argument("Obstacle bitmap has invalid dimensions");
+    }
+
+    clear();
+    for (int i = 1; i < width - 1; i++)
+    {
+        int px = static_cast<int>(static_cast<long long>(i) * bitmapWidth / width);
+        for (int j = 1; j < height - 1; j++)
+        {
+            int py = static_cast<int>(static_cast<long long>(j) * bitmapHeight / height);
+            if (pixels[static_cast<std::size_t>(py) * pitch + px])
+                set(i, j, true);
+        }
+    }
+}
+
+// Solid cells next to fluid are listed once per boundary type, each with the
+// fluid interior cells around it that its value is taken from
+void ObstacleMask::updateBoundaryCells()
+{
+    solidRuns.clear();
+    for (std::vector<BoundaryCell> &cells : boundaryCells)
+    {
+        cells.clear();
+    }
+
+    const int offsets[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    for (int i = 1; i < width - 1; i++)
+    {
+        if (rowSolidCounts[i] == 0)
+            continue;
+
+        const std::uint64_t *row = &bits[static_cast<std::size_t>(i) * wordsPerRow];
+        for (int runBegin = findCell(row, 1, height - 1, true); runBegin < height - 1;)
+        {
+            int runEnd = findCell(row, runBegin, height - 1, false);
+            solidRuns.push_back({i, runBegin, runEnd});
+            runBegin = findCell(row, runEnd, height - 1, true);
+        }
+
+        for (int j = findCell(row, 1, height - 1, true); j < height - 1; j = findCell(row, j + 1, height - 1, true))
+        {
+            bool fluid[4];
+            for (int k = 0; k < 4; k++)
+            {
+                int x = i + offsets[k][0];
+                int y = j + offsets[k][1];
+                fluid[k] = x >= 1 && x < width - 1 && y >= 1 && y < height - 1 && !isSolid(x, y);
+            }
+            if (!fluid[0] && !fluid[1] && !fluid[2] && !fluid[3])
+                continue;
+
+            for (int b = 0; b < 3; b++)
+            {
+                // Neighbours across the faces normal to the component
+                // (k < 2 for x, k >= 2 for y) are mirrored; without any,
+                // the tangential ones are copied
+                int first = 0, last = 4;
+                float sign = 1.0f;
+                if (b != 0)
+                {
+                    int normal = b == 1 ? 0 : 2;
+                    if (fluid[normal] || fluid[normal + 1])
+                    {
+                        first = normal;
+                        sign = -1.0f;
+                    }
+                    else
+                    {
+                        first = 2 - normal;
+                    }
+                    last = first + 2;
+                }
+
+                BoundaryCell cell = {i, j, 0, 0.0f, {}, {}};
+                for (int k = first; k < last; k++)
+                {
+                    if (!fluid[k])
+                        continue;
+                    cell.offsetX[cell.count] = static_cast<signed char>(offsets[k][0]);
+                    cell.offsetY[cell.count] = static_cast<signed char>(offsets[k][1]);
+                    cell.count++;
+                }
+                cell.weight = sign / cell.count;
+                boundaryCells[b].push_back(cell);
+            }
+        }
+    }
+    changed = false;
+}
+
+void ObstacleMask::apply(int b, Field &x) const
+{
+    switch (b)
+    {
+    case 1:
+        apply<1>(x);
+        break;
+    case 2:
+        apply<2>(x);
+        break;
+    default:
+        apply<0>(x);
+        break;
+    }
+}
+
+int ObstacleMask::findCell(const std::uint64_t *row, int j, int end, bool solid)
+{
+    while (j < end)
+    {
+        std::uint64_t word = row[j >> 6];
+        if (!solid)
+            word = ~word;
+        word >>= j & 63;
+        if (word != 0)
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            int bit = __builtin_ctzll(word);
+#else
+            int bit = 0;
+            while (!(word & 1))
+            {
+                word >>= 1;
+                bit++;
+            }
+#endif
+            return std::min(end, j + bit);
+        }
+        j = (j | 63) + 1;
+    }
+    return end;
+}
@@ -0,0 +1,354 @@
+#include "pcg.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Tuning constants of the modified incomplete Cholesky factorization
+const float MIC_TAU = 0.97f;  // Fraction of dropped fill-in moved to the diagonal
+const float MIC_SIGMA = 0.25f; // Fall back to the plain diagonal below this ratio
+
+double dot(ThreadPool *pool, const Field &a, const Field &b)
+{
+    return parallelSum(pool, 1, a.getWidth() - 1, [&](int rowBegin, int rowEnd)
+    {
+        double sum = 0.0;
+        for (int i = rowBegin; i < rowEnd; i++)
+        {
+            for (int j = 1; j < a.getHeight() - 1; j++)
+            {
+                sum += static_cast<double>(a(i, j)) * b(i, j);
+            }
+        }
+        return sum;
+    });
+}
+
+float maxAbs(ThreadPool *pool, const Field &a)
+{
+    return parallelMax(pool, 1, a.getWidth() - 1, [&](int rowBegin, int rowEnd)
+    {
+        float result = 0.0f;
+        for (int i = rowBegin; i < rowEnd; i++)
+        {
+            for (int j = 1; j < a.getHeight() - 1; j++)
+            {
+                result = std::max(result, std::fabs(a(i, j)));
+            }
+        }
+        return result;
+    });
+}
+
+// Call fn(jBegin, jEnd) for the runs of interior cells of row i that are
+// not solid
+template <typename Fn>
+void forEachFluidSpan(const ObstacleMask *obstacles, int i, int height, Fn fn)
+{
+    if (obstacles)
+        obstacles->forEachFluidSpan(i, 1, height - 1, fn);
+    else
+        fn(1, height - 1);
+}
+
+// Remove the mean over the fluid cells so the system is consistent with the
+// constant null space of the pure-Neumann operator
+void removeMean(ThreadPool *pool, Field &a, const ObstacleMask *obstacles)
+{
+    double sum = parallelSum(pool, 1, a.getWidth() - 1, [&](int rowBegin, int rowEnd)
+    {
+        double partial = 0.0;
+        for (int i = rowBegin; i < rowEnd; i++)
+        {
+            forEachFluidSpan(obstacles, i, a.getHeight(), [&](int jBegin, int jEnd)
+            {
+                for (int j = jBegin; j < jEnd; j++)
+                {
+                    partial += a(i, j);
+                }
+            });
+        }
+        return partial;
+    });
+
+    long long cells = static_cast<long long>(a.getWidth() - 2) * (a.getHeight() - 2);
+    if (obstacles)
+        cells -= obstacles->getSolidCount();
+    if (cells <= 0)
+        return;
+    float mean = static_cast<float>(sum / cells);
+    parallelFor(pool, 1, a.getWidth() - 1, [&](int rowBegin, int rowEnd)
+    {
+        for (int i = rowBegin; i < rowEnd; i++)
+        {
+            forEachFluidSpan(obstacles, i, a.getHeight(), [&](int jBegin, int jEnd)
+            {
+                for (int j = jBegin; j < jEnd; j++)
+                {
+                    a(i, j) -= mean;
+                }
+            });
+        }
+    });
+}
+}
+
+void ConjugateGradientSolver::resize(int width, int height)
+{
+    for (Field *field : {&residual, &auxiliary, &search, &product, &icDiagonal})
+    {
+        field->resize(width, height);
+    }
+    factorIncompleteCholesky();
+}
+
+void ConjugateGradientSolver::setObstacles(const ObstacleMask *mask)
+{
+    obstacles = mask && !mask->empty() ? mask : nullptr;
+    if (icDiagonal.getWidth() > 0)
+        factorIncompleteCholesky();
+}
+
+// Number of interior fluid neighbours of interior cell (i, j), i.e. the
+// diagonal of the operator once the zero-gradient walls are folded in; zero
+// for a solid cell
+float ConjugateGradientSolver::operatorDiagonal(int i, int j) const
+{
+    int width = icDiagonal.getWidth();
+    int height = icDiagonal.getHeight();
+    float diagonal = 4.0f - (i == 1) - (i == width - 2) - (j == 1) - (j == height - 2);
+    if (obstacles)
+    {
+        if (obstacles->isSolid(i, j))
+            return 0.0f;
+        diagonal -= obstacles->isSolid(i + 1, j) + obstacles->isSolid(i - 1, j) + obstacles->isSolid(i, j + 1) +
+                    obstacles->isSolid(i, j - 1);
+    }
+    return diagonal;
+}
+
+SolverStats ConjugateGradientSolver::solve(Field &p, const Field &rhs, const PcgSettings &settings)
+{
+    int width = p.getWidth();
+    int height = p.getHeight();
+    if (residual.getWidth() != width || residual.getHeight() != height)
+    {
+        resize(width, height);
+    }
+
+    SolverStats stats;
+
+    // r = rhs - A p
+    applyBoundary(0, p);
+    applyOperator(p, product);
+    parallelFor(threadPool, 1, width - 1, [&](int rowBegin, int rowEnd)
+    {
+        for (int i = rowBegin; i < rowEnd; i++)
+        {
+            for (int j = 1; j < height - 1; j++)
+            {
+                residual(i, j) = obstacles && obstacles->isSolid(i, j) ? 0.0f : rhs(i, j) - product(i, j);
+            }
+        }
+    });
+    removeMean(threadPool, residual, obstacles);
+
+    // Without a right-hand side the solution is constant, so a warm-started
+    // p is simply cleared
+    float rhsNorm = maxAbs(threadPool, rhs);
+    if (rhsNorm == 0.0f)
+    {
+        p.fill(0.0f);
+        return stats;
+    }
+    float target = settings.tolerance * rhsNorm;
+    float residualNorm = maxAbs(threadPool, residual);
+    if (residualNorm <= target)
+    {
+        stats.residual = residualNorm / rhsNorm;
+        return stats;
+    }
+
+    applyPreconditioner(residual, auxiliary, settings.preconditioner);
+    search.copyFrom(auxiliary);
+    double sigma = dot(threadPool, auxiliary, residual);
+
+    while (stats.iterations < settings.maxIterations)
+    {
+        stats.iterations++;
+
+        applyOperator(search, product);
+        float alpha = static_cast<float>(sigma / dot(threadPool, search, product));
+        parallelFor(threadPool, 1, width - 1, [&](int rowBegin, int rowEnd)
+        {
+            for (int i = rowBegin; i < rowEnd; i++)
+            {
+                for (int j = 1; j < height - 1; j++)
+                {
+                    p(i, j) += alpha * search(i, j);
+                    residual(i, j) -= alpha * product(i, j);
+                }
+            }
+        });
+
+        residualNorm = maxAbs(threadPool, residual);
+        if (residualNorm <= target)
+            break;
+
+        applyPreconditioner(residual, auxiliary, settings.preconditioner);
+        double sigmaNew = dot(threadPool, auxiliary, residual);
+        float beta = static_cast<float>(sigmaNew / sigma);
+        parallelFor(threadPool, 1, width - 1, [&](int rowBegin, int rowEnd)
+        {
+            for (int i = rowBegin; i < rowEnd; i++)
+            {
+                for (int j = 1; j < height - 1; j++)
+                {
+                    search(i, j) = auxiliary(i, j) + beta * search(i, j);
+                }
+            }
+        });
+        sigma = sigmaNew;
+    }
+
+    applyBoundary(0, p);
+    stats.residual = residualNorm / rhsNorm;
+    return stats;
+}
+
+// result = A x on the interior; refreshes the ghost cells of x first so the
+// plain 5-point stencil sees the zero-gradient walls. Solid neighbours add
+// no term, and solid cells get zero.
+void ConjugateGradientSolver::applyOperator(Field &x, Field &result)
+{
+    applyBoundary(0, x);
+    parallelFor(threadPool, 1, x.getWidth() - 1, [&](int rowBegin, int rowEnd)
+    {
+        for (int i = rowBegin; i < rowEnd; i++)
+        {
+            if (!obstacles)
+            {
+                for (int j = 1; j < x.getHeight() - 1; j++)
+                {
+                    result(i, j) = 4.0f * x(i, j) - x(i + 1, j) - x(i - 1, j) - x(i, j + 1) - x(i, j - 1);
+                }
+                continue;
+            }
+
+            for (int j = 1; j < x.getHeight() - 1; j++)
+            {
+                if (obstacles->isSolid(i, j))
+                {
+                    result(i, j) = 0.0f;
+                    continue;
+                }
+                float centre = x(i, j);
+                float sum = 0.0f;
+                if (!obstacles->isSolid(i + 1, j))
+                    sum += centre - x(i + 1, j);
+                if (!obstacles->isSolid(i - 1, j))
+                    sum += centre - x(i - 1, j);
+                if (!obstacles->isSolid(i, j + 1))
+                    sum += centre - x(i, j + 1);
+                if (!obstacles->isSolid(i, j - 1))
+                    sum += centre - x(i, j - 1);
+                result(i, j) = sum;
+            }
+        }
+    });
+}
+
+void ConjugateGradientSolver::applyPreconditioner(const Field &r, Field &z, Preconditioner preconditioner)
+{
+    int width = r.getWidth();
+    int height = r.getHeight();
+
+    if (preconditioner == Preconditioner::Jacobi)
+    {
+        parallelFor(threadPool, 1, width - 1, [&](int rowBegin, int rowEnd)
+        {
+            for (int i = rowBegin; i < rowEnd; i++)
+            {
+                for (int j = 1; j < height - 1; j++)
+                {
+                    float diagonal = operatorDiagonal(i, j);
+                    z(i, j) = diagonal > 0.0f ? r(i, j) / diagonal : 0.0f;
+                }
+            }
+        });
+        return;
+    }
+
+    // Forward substitution L q = r (q is stored in z). Off-diagonal entries of
+    // the operator are -1 between neighbouring interior cells; solid cells
+    // have a zero factor, so they stay zero and drop out of their neighbours'
+    // sums. The triangular solves are inherently sequential and run on the
+    // calling thread.
+    for (int i = 1; i < width - 1; i++)
+    {
+        for (int j = 1; j < height - 1; j++)
+        {
+            float t = r(i, j);
+            if (i > 1)
+                t += icDiagonal(i - 1, j) * z(i - 1, j);
+            if (j > 1)
+                t += icDiagonal(i, j - 1) * z(i, j - 1);
+            z(i, j) = t * icDiagonal(i, j);
+        }
+    }
+
+    // Back substitution L^T z = q
+    for (int i = width - 2; i >= 1; i--)
+    {
+        for (int j = height - 2; j >= 1; j--)
+        {
+            float t = z(i, j);
+            if (i < width - 2)
+                t += icDiagonal(i, j) * z(i + 1, j);
+            if (j < height - 2)
+                t += icDiagonal(i, j) * z(i, j + 1);
+            z(i, j) = t * icDiagonal(i, j);
+        }
+    }
+}
+
+// Modified incomplete Cholesky, MIC(0), of the pressure operator
+void ConjugateGradientSolver::factorIncompleteCholesky()
+{
+    int width = icDiagonal.getWidth();
+    int height = icDiagonal.getHeight();
+
+    for (int i = 1; i < width - 1; i++)
+    {
+        for (int j = 1; j < height - 1; j++)
+        {
+            float diagonal = operatorDiagonal(i, j);
+            if (diagonal == 0.0f)
+            {
+                icDiagonal(i, j) = 0.0f;
+                continue;
+            }
+
+            // Fill-in only arises where the earlier neighbour is coupled to
+            // the cell diagonally across from this one
+            float e = diagonal;
+            if (i > 1)
+            {
+                float previous = icDiagonal(i - 1, j);
+                e -= previous * previous;
+                if (j < height - 2 && !(obstacles && obstacles->isSolid(i - 1, j + 1)))
+                    e -= MIC_TAU * previous * previous;
+            }
+            if (j > 1)
+            {
+                float previous = icDiagonal(i, j - 1);
+                e -= previous * previous;
+                if (i < width - 2 && !(obstacles && obstacles->isSolid(i + 1, j - 1)))
+                    e -= MIC_TAU * previous * previous;
+            }
+            if (e < MIC_SIGMA * diagonal)
+                e = diagonal;
+            icDiagonal(i, j) = 1.0f / std::sqrt(e);
+        }
+    }
+}
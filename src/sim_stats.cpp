@@ -0,0 +1,106 @@
+#include "sim_stats.h"
+#include <iomanip>
+#include <ostream>
+
+const char *getStageName(Stage stage)
+{
+    switch (stage)
+    {
+    case Stage::VelocityStep:
+        return "velocity_step";
+    case Stage::DensityStep:
+        return "density_step";
+    case Stage::Diffuse:
+        return "diffuse";
+    case Stage::Advect:
+        return "advect";
+    case Stage::Project:
+        return "project";
+    case Stage::Boundary:
+        return "boundary";
+    default:
+        return "unknown";
+    }
+}
+
+void TraceRecorder::start(std::size_t newCapacity)
+{
+    if (!started)
+    {
+        origin = std::chrono::steady_clock::now();
+        started = true;
+    }
+    capacity = newCapacity;
+    events.reserve(capacity);
+    recording = true;
+}
+
+void TraceRecorder::clear()
+{
+    events.clear();
+    dropped = 0;
+    started = false;
+}
+
+void TraceRecorder::record(Stage stage, std::chrono::steady_clock::time_point begin,
+                           std::chrono::steady_clock::time_point end)
+{
+    if (events.size() >= capacity)
+    {
+        dropped++;
+        return;
+    }
+
+    typedef std::chrono::duration<double, std::micro> Microseconds;
+    events.push_back({stage, Microseconds(begin - origin).count(), Microseconds(end - begin).count()});
+}
+
+void writeStatsCsv(std::ostream &out, const SimStats &stats)
+{
+    out << "stage,calls,cells,total_ms,ms_per_step,ns_per_cell\n";
+    for (int s = 0; s < STAGE_COUNT; s++)
+    {
+        const StageStats &stage = stats.stages[s];
+        out << getStageName(static_cast<Stage>(s)) << "," << stage.calls << "," << stage.cells << ","
+            << stage.seconds * 1e3 << "," << (stats.steps > 0 ? stage.seconds * 1e3 / stats.steps : 0.0) << ","
+            << (stage.cells > 0 ? stage.seconds * 1e9 / stage.cells : 0.0) << "\n";
+    }
+}
+
+void writeStatsJson(std::ostream &out, const SimStats &stats)
+{
+    out << "{\"steps\":" << stats.steps
+        << ",\"substeps\":" << stats.substeps
+        << ",\"pressure_solves\":" << stats.pressureSolves
+        << ",\"pressure_iterations\":" << stats.pressureIterations
+        << ",\"worst_pressure_residual\":" << stats.worstPressureResidual
+        << ",\"diffusion_solves\":" << stats.diffusionSolves
+        << ",\"diffusion_iterations\":" << stats.diffusionIterations
+        << ",\"worst_diffusion_residual\":" << stats.worstDiffusionResidual
+        << ",\"stages\":{";
+    for (int s = 0; s < STAGE_COUNT; s++)
+    {
+        const StageStats &stage = stats.stages[s];
+        out << (s > 0 ? "," : "") << "\"" << getStageName(static_cast<Stage>(s)) << "\":{\"calls\":" << stage.calls
+            << ",\"cells\":" << stage.cells << ",\"total_ms\":" << stage.seconds * 1e3 << "}";
+    }
+    out << "}}\n";
+}
+
+void writeChromeTrace(std::ostream &out, const std::vector<TraceEvent> &events)
+{
+    // Timestamps grow large over a long recording; keep sub-microsecond digits
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision(3);
+    out << std::fixed << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (std::size_t k = 0; k < events.size(); k++)
+    {
+        const TraceEvent &event = events[k];
+        out << (k > 0 ? ",\n" : "\n") << "{\"name\":\"" << getStageName(event.stage)
+            << "\",\"cat\":\"fluid_sim\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << event.startMicroseconds
+            << ",\"dur\":" << event.durationMicroseconds << "}";
+    }
+    out << "\n]}\n";
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,101 @@
+#include "simulation_thread.h"
+#include <chrono>
+
+SimulationThread::SimulationThread(FluidSim &sim, float dt, double stepsPerSecond)
+    : sim(sim), dt(dt), stepsPerSecond(stepsPerSecond)
+{
+}
+
+SimulationThread::~SimulationThread()
+{
+    stop();
+}
+
+void SimulationThread::start()
+{
+    if (running)
+        return;
+
+    // Give the reader the initial state before the first step finishes
+    publishFrame();
+    running = true;
+    thread = std::thread(&SimulationThread::run, this);
+}
+
+void SimulationThread::stop()
+{
+    running = false;
+    if (thread.joinable())
+        thread.join();
+}
+
+const SimFrame &SimulationThread::acquireFrame()
+{
+    frames.update();
+    return frames.getFront();
+}
+
+void SimulationThread::run()
+{
+    typedef std::chrono::steady_clock Clock;
+    Clock::duration period = Clock::duration::zero();
+    if (stepsPerSecond > 0.0)
+    {
+        period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / stepsPerSecond));
+    }
+    Clock::time_point deadline = Clock::now();
+
+    while (running)
+    {
+        SimInput input;
+        while (inputs.pop(input))
+        {
+            applyInput(input);
+        }
+
+        sim.step(dt);
+        steps++;
+        publishFrame();
+
+        if (period != Clock::duration::zero())
+        {
+            // Hold to real time; after falling behind, restart the schedule
+            // instead of running a burst of steps to catch up
+            deadline += period;
+            Clock::time_point now = Clock::now();
+            if (deadline < now)
+                deadline = now;
+            else
+                std::this_thread::sleep_until(deadline);
+        }
+    }
+}
+
+void SimulationThread::applyInput(const SimInput &input)
+{
+    switch (input.kind)
+    {
+    case SimInput::Kind::Splat:
+        sim.addSplat(input.splat);
+        break;
+    case SimInput::Kind::Obstacle:
+        sim.getObstacles().fillDisc(input.splat.x, input.splat.y, input.splat.radius, true);
+        break;
+    case SimInput::Kind::ClearObstacles:
+        sim.getObstacles().clear();
+        break;
+    case SimInput::Kind::Reset:
+        sim.reset();
+        break;
+    }
+}
+
+void SimulationThread::publishFrame()
+{
+    SimFrame &frame = frames.getBack();
+    frame.density.copyFrom(sim.getDensityView());
+    frame.velocityX.copyFrom(sim.getVelocityXView());
+    frame.velocityY.copyFrom(sim.getVelocityYView());
+    frame.step = steps;
+    frames.publish();
+}
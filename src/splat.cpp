@@ -0,0 +1,94 @@
+#include "splat.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+// floor(value) limited to [0, limit], clamped while still a float so the
+// conversion is defined however far off the grid value lies
+int clampedFloor(float value, int limit)
+{
+    return static_cast<int>(std::floor(std::min(std::max(value, 0.0f), static_cast<float>(limit))));
+}
+
+// dest[j] += amount * weights[j - jBegin] over the bounds' columns
+void addRow(float *dest, const float *weights, float amount, const SplatBounds &bounds)
+{
+    for (int j = bounds.jBegin; j < bounds.jEnd; j++)
+    {
+        dest[j] += amount * weights[j - bounds.jBegin];
+    }
+}
+}
+
+SplatBounds getSplatBounds(const Splat &splat, int width, int height)
+{
+    // A splat with a non-finite value would spread NaN or infinity over
+    // every cell it reaches, so it reaches none
+    const float values[] = {splat.x, splat.y, splat.radius, splat.density, splat.velocityX, splat.velocityY};
+    for (float value : values)
+    {
+        if (!std::isfinite(value))
+            return {1, 1, 1, 1};
+    }
+
+    float reach = splat.shape == SplatShape::Disc ? splat.radius : 3.0f * splat.radius;
+    SplatBounds bounds;
+    bounds.iBegin = std::max(1, clampedFloor(splat.x - reach, width));
+    bounds.iEnd = std::min(width - 1, clampedFloor(splat.x + reach, width) + 1);
+    bounds.jBegin = std::max(1, clampedFloor(splat.y - reach, height));
+    bounds.jEnd = std::min(height - 1, clampedFloor(splat.y + reach, height) + 1);
+    return bounds;
+}
+
+void rasterizeSplat(const Splat &splat, float scale, const SplatBounds &bounds, std::vector<float> &weights,
+                    Field &density, Field &velocityX, Field &velocityY)
+{
+    if (bounds.iBegin >= bounds.iEnd || bounds.jBegin >= bounds.jEnd || splat.radius <= 0.0f)
+        return;
+
+    float radiusSquared = splat.radius * splat.radius;
+    float densityAmount = scale * splat.density;
+    float velocityXAmount = scale * splat.velocityX;
+    float velocityYAmount = scale * splat.velocityY;
+
+    // Weights along y. The Gaussian is separable, so its column factors are
+    // computed once and each row only scales them; a disc recomputes them
+    // per row from the chord the row cuts.
+    weights.resize(bounds.jEnd - bounds.jBegin);
+    if (splat.shape == SplatShape::Gaussian)
+    {
+        for (int j = bounds.jBegin; j < bounds.jEnd; j++)
+        {
+            float dy = j - splat.y;
+            weights[j - bounds.jBegin] = std::exp(-dy * dy / radiusSquared);
+        }
+    }
+
+    for (int i = bounds.iBegin; i < bounds.iEnd; i++)
+    {
+        float dx = i - splat.x;
+        float rowWeight = 1.0f;
+        if (splat.shape == SplatShape::Gaussian)
+        {
+            rowWeight = std::exp(-dx * dx / radiusSquared);
+        }
+        else
+        {
+            float remaining = radiusSquared - dx * dx;
+            for (int j = bounds.jBegin; j < bounds.jEnd; j++)
+            {
+                float dy = j - splat.y;
+                weights[j - bounds.jBegin] = dy * dy < remaining ? 1.0f : 0.0f;
+            }
+        }
+
+        if (densityAmount != 0.0f)
+            addRow(density.row(i), weights.data(), densityAmount * rowWeight, bounds);
+        if (velocityXAmount != 0.0f)
+            addRow(velocityX.row(i), weights.data(), velocityXAmount * rowWeight, bounds);
+        if (velocityYAmount != 0.0f)
+            addRow(velocityY.row(i), weights.data(), velocityYAmount * rowWeight, bounds);
+    }
+}
@@ -0,0 +1,86 @@
+#include "storage_precision.h"
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+namespace
+{
+// Spread the low five bits of x to the even bit positions
+int spreadBits(int x)
+{
+    int result = 0;
+    for (int bit = 0; bit < 5; bit++)
+    {
+        result |= ((x >> bit) & 1) << (2 * bit);
+    }
+    return result;
+}
+}
+
+void SampleField::resize(int newWidth, int newHeight, FieldLayout newLayout)
+{
+    if (newWidth <= 0 || newHeight <= 0)
+    {
+        throw std::invalid_argument("Field dimensions must be positive");
+    }
+
+    width = newWidth;
+    height = newHeight;
+    layout = newLayout;
+    rowOffsets.clear();
+    columnOffsets.clear();
+
+    // Cell (x, y) of a blocked layout is at rowOffsets[x] + columnOffsets[y]:
+    // the block's position and the cell's place within it both split into
+    // a part set by x and a part set by y
+    std::size_t cells;
+    if (layout == FieldLayout::Tiled || layout == FieldLayout::Morton)
+    {
+        int shift = layout == FieldLayout::Tiled ? 3 : 5;
+        int side = 1 << shift;
+        int blocksX = (width + side - 1) / side;
+        int blocksY = (height + side - 1) / side;
+        int blockCells = side * side;
+
+        stride = 0;
+        blockRows = side;
+        rowOffsets.resize(width);
+        columnOffsets.resize(height);
+        for (int x = 0; x < width; x++)
+        {
+            int inner = layout == FieldLayout::Tiled ? (x & (side - 1)) * side : spreadBits(x & (side - 1)) << 1;
+            rowOffsets[x] = (x >> shift) * blocksY * blockCells + inner;
+        }
+        for (int y = 0; y < height; y++)
+        {
+            int inner = layout == FieldLayout::Tiled ? y & (side - 1) : spreadBits(y & (side - 1));
+            columnOffsets[y] = (y >> shift) * blockCells + inner;
+        }
+        cells = static_cast<std::size_t>(blocksX) * blocksY * blockCells;
+    }
+    else
+    {
+        stride = rowStride(height, layout);
+        blockRows = 1;
+        cells = static_cast<std::size_t>(width) * stride;
+    }
+
+    // Rounded up to the alignment, as aligned_alloc requires
+    std::size_t bytes = cells * sizeof(float);
+    bytes = (bytes + FIELD_ALIGNMENT - 1) / FIELD_ALIGNMENT * FIELD_ALIGNMENT;
+
+    float *memory = static_cast<float *>(std::aligned_alloc(FIELD_ALIGNMENT, bytes));
+    if (!memory)
+    {
+        throw std::bad_alloc();
+    }
+    storage.reset(memory);
+    std::memset(memory, 0, bytes);
+}
+
+StorageView SampleField::view() const
+{
+    if (rowOffsets.empty())
+        return {storage.get(), width, height, stride, 0, nullptr, nullptr};
+    return {storage.get(), width, height, 0, 0, rowOffsets.data(), columnOffsets.data()};
+}
@@ -0,0 +1,139 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threadCount)
+{
+    if (threadCount <= 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (int t = 1; t < threadCount; t++)
+    {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(int begin, int end, const std::function<void(int, int)> &fn)
+{
+    run(begin, end, [&fn](int, int bandBegin, int bandEnd) { fn(bandBegin, bandEnd); });
+}
+
+void ThreadPool::parallelForBands(int begin, int end, const std::function<void(int, int, int)> &fn)
+{
+    run(begin, end, fn);
+}
+
+double ThreadPool::parallelSum(int begin, int end, const std::function<double(int, int)> &fn)
+{
+    std::vector<double> partials(std::max(1, bandsFor(begin, end)), 0.0);
+    run(begin, end, [&](int band, int bandBegin, int bandEnd) { partials[band] = fn(bandBegin, bandEnd); });
+
+    double sum = 0.0;
+    for (double partial : partials)
+    {
+        sum += partial;
+    }
+    return sum;
+}
+
+float ThreadPool::parallelMax(int begin, int end, const std::function<float(int, int)> &fn)
+{
+    std::vector<float> partials(std::max(1, bandsFor(begin, end)), 0.0f);
+    run(begin, end, [&](int band, int bandBegin, int bandEnd) { partials[band] = fn(bandBegin, bandEnd); });
+    return *std::max_element(partials.begin(), partials.end());
+}
+
+int ThreadPool::bandsFor(int begin, int end) const
+{
+    int rows = end - begin;
+    if (rows <= 0)
+        return 0;
+    return std::max(1, std::min(getThreadCount(), rows / MIN_ROWS_PER_BAND));
+}
+
+void ThreadPool::run(int begin, int end, const BandTask &fn)
+{
+    int bands = bandsFor(begin, end);
+    if (bands == 0)
+        return;
+    if (bands == 1)
+    {
+        fn(0, begin, end);
+        return;
+    }
+
+    {
+        // A worker that woke too late for the previous job may still be
+        // draining it; let it leave before the job parameters change
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return activeWorkers == 0; });
+
+        task = &fn;
+        taskBegin = begin;
+        taskEnd = end;
+        bandCount = bands;
+        nextBand = 0;
+        completedBands = 0;
+        generation++;
+    }
+    wake.notify_all();
+
+    runBands();
+
+    // Wait for every band and for every worker to leave this job, so none
+    // can pick up bands of the next one with stale parameters
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return completedBands == bandCount && activeWorkers == 0; });
+    task = nullptr;
+}
+
+void ThreadPool::runBands()
+{
+    int rows = taskEnd - taskBegin;
+    int band;
+    while ((band = nextBand.fetch_add(1)) < bandCount)
+    {
+        int bandBegin = taskBegin + static_cast<int>(static_cast<long long>(rows) * band / bandCount);
+        int bandEnd = taskBegin + static_cast<int>(static_cast<long long>(rows) * (band + 1) / bandCount);
+        (*task)(band, bandBegin, bandEnd);
+        completedBands.fetch_add(1);
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    std::uint64_t seenGeneration = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping)
+                return;
+            seenGeneration = generation;
+            activeWorkers++;
+        }
+
+        runBands();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            activeWorkers--;
+        }
+        done.notify_all();
+    }
+}
@@ -0,0 +1,54 @@
+#include "tile_mask.h"
+#include <algorithm>
+
+void TileMask::resize(int width, int height)
+{
+    tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    flags.assign(static_cast<std::size_t>(tilesX) * tilesY, 1);
+    scratch.resize(flags.size());
+}
+
+void TileMask::setAll(bool active)
+{
+    std::fill(flags.begin(), flags.end(), active ? 1 : 0);
+}
+
+int TileMask::getActiveCount() const
+{
+    return static_cast<int>(std::count(flags.begin(), flags.end(), 1));
+}
+
+// Separable: a running window along y into scratch, then along x back
+void TileMask::dilate(int radius)
+{
+    if (radius <= 0)
+        return;
+
+    for (int tx = 0; tx < tilesX; tx++)
+    {
+        const unsigned char *source = &flags[tx * tilesY];
+        unsigned char *dest = &scratch[tx * tilesY];
+        for (int ty = 0; ty < tilesY; ty++)
+        {
+            int begin = std::max(0, ty - radius);
+            int end = std::min(tilesY, ty + radius + 1);
+            dest[ty] = std::find(source + begin, source + end, 1) != source + end;
+        }
+    }
+
+    for (int tx = 0; tx < tilesX; tx++)
+    {
+        int begin = std::max(0, tx - radius);
+        int end = std::min(tilesX, tx + radius + 1);
+        for (int ty = 0; ty < tilesY; ty++)
+        {
+            unsigned char active = 0;
+            for (int sx = begin; sx < end && !active; sx++)
+            {
+                active = scratch[sx * tilesY + ty];
+            }
+            flags[tx * tilesY + ty] = active;
+        }
+    }
+}
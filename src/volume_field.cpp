@@ -0,0 +1,164 @@
+#include "volume_field.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+VolumeField::VolumeField(int width, int height, int depth)
+{
+    resize(width, height, depth);
+}
+
+void VolumeField::resize(int newWidth, int newHeight, int newDepth)
+{
+    if (newWidth <= 0 || newHeight <= 0 || newDepth <= 0)
+    {
+        throw std::invalid_argument("Volume dimensions must be positive");
+    }
+
+    width = newWidth;
+    height = newHeight;
+    depth = newDepth;
+
+    // aligned_alloc requires the size to be a multiple of the alignment
+    std::size_t bytes = getSize() * sizeof(float);
+    bytes = (bytes + FIELD_ALIGNMENT - 1) / FIELD_ALIGNMENT * FIELD_ALIGNMENT;
+
+    float *memory = static_cast<float *>(std::aligned_alloc(FIELD_ALIGNMENT, bytes));
+    if (!memory)
+    {
+        throw std::bad_alloc();
+    }
+    storage.reset(memory);
+    std::memset(memory, 0, bytes);
+}
+
+void VolumeField::fill(float value)
+{
+    std::fill(storage.get(), storage.get() + getSize(), value);
+}
+
+void VolumeField::copyFrom(const VolumeField &other)
+{
+    if (other.width != width || other.height != height || other.depth != depth)
+    {
+        resize(other.width, other.height, other.depth);
+    }
+    std::memcpy(storage.get(), other.storage.get(), getSize() * sizeof(float));
+}
+
+// Set boundary conditions on the outer walls of a volume
+template <int B>
+void applyBoundary(VolumeField &x)
+{
+    int width = x.getWidth();
+    int height = x.getHeight();
+    int depth = x.getDepth();
+
+    // Walls
+    for (int i = 1; i < width - 1; i++)
+    {
+        for (int j = 1; j < height - 1; j++)
+        {
+            float *line = x.line(i, j);
+            line[0] = B == 3 ? -line[1] : line[1];
+            line[depth - 1] = B == 3 ? -line[depth - 2] : line[depth - 2];
+        }
+
+        const float *first = x.line(i, 1);
+        const float *last = x.line(i, height - 2);
+        float *low = x.line(i, 0);
+        float *high = x.line(i, height - 1);
+        for (int k = 1; k < depth - 1; k++)
+        {
+            low[k] = B == 2 ? -first[k] : first[k];
+            high[k] = B == 2 ? -last[k] : last[k];
+        }
+    }
+
+    for (int j = 1; j < height - 1; j++)
+    {
+        const float *first = x.line(1, j);
+        const float *last = x.line(width - 2, j);
+        float *low = x.line(0, j);
+        float *high = x.line(width - 1, j);
+        for (int k = 1; k < depth - 1; k++)
+        {
+            low[k] = B == 1 ? -first[k] : first[k];
+            high[k] = B == 1 ? -last[k] : last[k];
+        }
+    }
+
+    // Edges, from the two wall cells beside them
+    for (int i : {0, width - 1})
+    {
+        int inI = i == 0 ? 1 : width - 2;
+        for (int j : {0, height - 1})
+        {
+            int inJ = j == 0 ? 1 : height - 2;
+            for (int k = 1; k < depth - 1; k++)
+            {
+                x(i, j, k) = 0.5f * (x(inI, j, k) + x(i, inJ, k));
+            }
+        }
+        for (int k : {0, depth - 1})
+        {
+            int inK = k == 0 ? 1 : depth - 2;
+            for (int j = 1; j < height - 1; j++)
+            {
+                x(i, j, k) = 0.5f * (x(inI, j, k) + x(i, j, inK));
+            }
+        }
+    }
+    for (int j : {0, height - 1})
+    {
+        int inJ = j == 0 ? 1 : height - 2;
+        for (int k : {0, depth - 1})
+        {
+            int inK = k == 0 ? 1 : depth - 2;
+            for (int i = 1; i < width - 1; i++)
+            {
+                x(i, j, k) = 0.5f * (x(i, inJ, k) + x(i, j, inK));
+            }
+        }
+    }
+
+    // Corners, from the three edge cells beside them
+    for (int i : {0, width - 1})
+    {
+        for (int j : {0, height - 1})
+        {
+            for (int k : {0, depth - 1})
+            {
+                int inI = i == 0 ? 1 : width - 2;
+                int inJ = j == 0 ? 1 : height - 2;
+                int inK = k == 0 ? 1 : depth - 2;
+                x(i, j, k) = (x(inI, j, k) + x(i, inJ, k) + x(i, j, inK)) / 3.0f;
+            }
+        }
+    }
+}
+
+template void applyBoundary<0>(VolumeField &x);
+template void applyBoundary<1>(VolumeField &x);
+template void applyBoundary<2>(VolumeField &x);
+template void applyBoundary<3>(VolumeField &x);
+
+void applyBoundary(int b, VolumeField &x)
+{
+    switch (b)
+    {
+    case 1:
+        applyBoundary<1>(x);
+        break;
+    case 2:
+        applyBoundary<2>(x);
+        break;
+    case 3:
+        applyBoundary<3>(x);
+        break;
+    default:
+        applyBoundary<0>(x);
+        break;
+    }
+}
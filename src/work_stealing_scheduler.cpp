@@ -0,0 +1,156 @@
+#include "work_stealing_scheduler.h"
+#include <algorithm>
+
+namespace
+{
+std::uint64_t packRange(std::uint32_t begin, std::uint32_t end)
+{
+    return static_cast<std::uint64_t>(begin) << 32 | end;
+}
+
+std::uint32_t rangeBegin(std::uint64_t range) { return static_cast<std::uint32_t>(range >> 32); }
+std::uint32_t rangeEnd(std::uint64_t range) { return static_cast<std::uint32_t>(range); }
+}
+
+WorkStealingScheduler::WorkStealingScheduler(int workerCount)
+{
+    if (workerCount <= 0)
+    {
+        workerCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    shares.reset(new Share[workerCount]);
+    for (int w = 1; w < workerCount; w++)
+    {
+        workers.emplace_back(&WorkStealingScheduler::workerLoop, this, w);
+    }
+}
+
+WorkStealingScheduler::~WorkStealingScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void WorkStealingScheduler::run(int taskCount, const std::function<void(int, int)> &fn)
+{
+    if (taskCount <= 0)
+        return;
+
+    int workerCount = getWorkerCount();
+    {
+        // Let stragglers from the previous batch leave before the shares
+        // are refilled
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return activeWorkers == 0; });
+
+        task = &fn;
+        for (int w = 0; w < workerCount; w++)
+        {
+            std::uint32_t begin = static_cast<std::uint32_t>(static_cast<long long>(taskCount) * w / workerCount);
+            std::uint32_t end = static_cast<std::uint32_t>(static_cast<long long>(taskCount) * (w + 1) / workerCount);
+            shares[w].range.store(packRange(begin, end));
+        }
+        generation++;
+    }
+    wake.notify_all();
+
+    work(0);
+
+    // Every share is empty once work() returns, so only tasks already
+    // started elsewhere remain; wait for the workers running them
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return activeWorkers == 0; });
+    task = nullptr;
+}
+
+bool WorkStealingScheduler::take(int worker, int &index)
+{
+    std::atomic<std::uint64_t> &range = shares[worker].range;
+    std::uint64_t current = range.load();
+    while (rangeBegin(current) < rangeEnd(current))
+    {
+        if (range.compare_exchange_weak(current, packRange(rangeBegin(current) + 1, rangeEnd(current))))
+        {
+            index = static_cast<int>(rangeBegin(current));
+            return true;
+        }
+    }
+    return false;
+}
+
+bool WorkStealingScheduler::steal(int worker)
+{
+    while (true)
+    {
+        // Largest remaining share, which halving drains fastest
+        int victim = -1;
+        std::uint64_t victimRange = 0;
+        std::uint32_t most = 0;
+        for (int w = 0; w < getWorkerCount(); w++)
+        {
+            std::uint64_t current = shares[w].range.load();
+            std::uint32_t remaining = rangeEnd(current) - rangeBegin(current);
+            if (w != worker && remaining > most)
+            {
+                victim = w;
+                victimRange = current;
+                most = remaining;
+            }
+        }
+        if (victim < 0)
+            return false;
+
+        // Leave the victim the front half, which it is working through
+        std::uint32_t begin = rangeBegin(victimRange);
+        std::uint32_t end = rangeEnd(victimRange);
+        std::uint32_t middle = begin + (end - begin) / 2;
+        if (shares[victim].range.compare_exchange_strong(victimRange, packRange(begin, middle)))
+        {
+            // Only this worker refills its own share, and it is empty now
+            shares[worker].range.store(packRange(middle, end));
+            steals += end - middle;
+            return true;
+        }
+    }
+}
+
+void WorkStealingScheduler::work(int worker)
+{
+    int index;
+    while (take(worker, index) || (steal(worker) && take(worker, index)))
+    {
+        (*task)(worker, index);
+    }
+}
+
+void WorkStealingScheduler::workerLoop(int worker)
+{
+    std::uint64_t seenGeneration = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping)
+                return;
+            seenGeneration = generation;
+            activeWorkers++;
+        }
+
+        work(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            activeWorkers--;
+        }
+        done.notify_all();
+    }
+}